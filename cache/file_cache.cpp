@@ -0,0 +1,376 @@
+#include "file_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "../log/log.h"
+#include "gzip_cache.h"
+
+// 目录中文件的内容、属性变化，以及文件被替换、删除，或目录本身被删除、移走
+static const uint32_t WATCH_MASK = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_CREATE |
+                                   IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF;
+
+file_entry::~file_entry() {
+    if (source) {
+        return;
+    }
+    if (addr) {
+        munmap(addr, st.st_size);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+file_cache::file_cache()
+    : m_shard_budget(0),
+      m_sendfile(false),
+      m_close_log(1),
+      m_epoch(0),
+      m_hits(0),
+      m_misses(0),
+      m_evictions(0),
+      m_invalidations(0),
+      m_entries(0),
+      m_bytes(0),
+      m_inotify_fd(-1) {}
+
+void file_cache::init(size_t budget, bool sendfile, int close_log) {
+    m_shard_budget = budget / SHARDS;
+    m_sendfile = sendfile;
+    m_close_log = close_log;
+    if (0 == m_shard_budget) {
+        return;
+    }
+
+    // 没有 inotify 就无法得知文件变化，不缓存
+    m_inotify_fd = inotify_init1(IN_CLOEXEC);
+    if (m_inotify_fd < 0) {
+        LOG_WARN("inotify unavailable, errno is:%d, file cache disabled", errno);
+        m_shard_budget = 0;
+        return;
+    }
+    if (pthread_create(&m_thread, NULL, worker, this) != 0) {
+        close(m_inotify_fd);
+        m_inotify_fd = -1;
+        m_shard_budget = 0;
+        return;
+    }
+    pthread_detach(m_thread);
+}
+
+file_cache::result file_cache::acquire(const char* path, file_ref& ref) {
+    if (0 == m_shard_budget) {
+        return load(path, ref);
+    }
+
+    std::string_view key(path);
+    shard& s = shard_of(key);
+    s.lock.lock();
+    auto it = s.index.find(key);
+    if (it != s.index.end()) {
+        s.lru.splice(s.lru.begin(), s.lru, it->second);
+        ref = *it->second;
+        s.lock.unlock();
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+        return FILE_OK;
+    }
+    s.lock.unlock();
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+
+    // 先记下失效计数并注册监视再打开文件，之后发生的修改一定能被发现
+    uint64_t epoch = m_epoch.load();
+    watch(path);
+    result ret = load(path, ref);
+    if (FILE_OK == ret) {
+        insert(ref, epoch);
+    }
+    return ret;
+}
+
+file_cache::result file_cache::load(const char* path, file_ref& ref) {
+    struct stat st;
+    if (stat(path, &st) < 0) {
+        return FILE_MISSING;
+    }
+    // 其他人不可读的文件不对外提供
+    if (!(st.st_mode & S_IROTH)) {
+        return FILE_FORBIDDEN;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        return FILE_DIRECTORY;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return FILE_MISSING;
+    }
+    // 以打开的文件为准，stat 之后文件可能已被替换
+    fstat(fd, &st);
+
+    std::shared_ptr<file_entry> entry = std::make_shared<file_entry>();
+    entry->path = path;
+    entry->st = st;
+    entry->mime = mime_type(path);
+    entry->vary = gzip_cache::negotiable(entry->mime, st.st_size);
+
+    if (m_sendfile) {
+        entry->fd = fd;
+    } else {
+        if (st.st_size > 0) {
+            void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (MAP_FAILED == addr) {
+                close(fd);
+                return FILE_MISSING;
+            }
+            entry->addr = (char*)addr;
+        }
+        close(fd);
+    }
+
+    char etag[64];
+    snprintf(etag, sizeof(etag), "\"%llx-%llx-%llx\"", (unsigned long long)st.st_ino, (unsigned long long)st.st_size,
+             (unsigned long long)st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec);
+    entry->etag = etag;
+    make_headers(*entry, st.st_mtime);
+
+    ref = std::move(entry);
+    return FILE_OK;
+}
+
+void file_cache::make_headers(file_entry& entry, time_t mtime) {
+    char date[32];
+    struct tm tm;
+    gmtime_r(&mtime, &tm);
+    strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+
+    char header[320];
+    int len = snprintf(header, sizeof(header), "ETag:%s\r\nLast-Modified:%s\r\n", entry.etag.c_str(), date);
+    entry.validators.assign(header, len);
+    if (entry.vary) {
+        entry.validators.append("Vary:Accept-Encoding\r\n");
+    }
+    len = snprintf(header, sizeof(header), "Content-Length:%lld\r\nContent-Type:%s\r\n", (long long)entry.st.st_size,
+                   entry.mime);
+    entry.header.assign(header, len);
+    if (entry.encoding) {
+        entry.header.append("Content-Encoding:").append(entry.encoding).append("\r\n");
+    }
+    entry.header.append("Accept-Ranges:bytes\r\n").append(entry.validators);
+}
+
+void file_cache::insert(file_ref& ref, uint64_t epoch) {
+    size_t size = ref->st.st_size;
+    if (size > m_shard_budget) {
+        return;
+    }
+
+    shard& s = shard_of(ref->path);
+    s.lock.lock();
+    if (m_epoch.load() != epoch) {
+        s.lock.unlock();
+        return;
+    }
+    auto it = s.index.find(ref->path);
+    if (it != s.index.end()) {
+        ref = *it->second;
+        s.lock.unlock();
+        return;
+    }
+
+    while (!s.lru.empty() && (s.bytes + size > m_shard_budget || s.index.size() >= (size_t)MAX_SHARD_ENTRIES)) {
+        erase(s, std::prev(s.lru.end()));
+        m_evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+    s.lru.push_front(ref);
+    s.index.emplace(std::string_view(ref->path), s.lru.begin());
+    s.bytes += size;
+    m_entries.fetch_add(1, std::memory_order_relaxed);
+    m_bytes.fetch_add(size, std::memory_order_relaxed);
+    s.lock.unlock();
+}
+
+void file_cache::erase(shard& s, std::list<file_ref>::iterator it) {
+    size_t size = (*it)->st.st_size;
+    // 索引的键指向缓存项中的路径，先删索引
+    s.index.erase((*it)->path);
+    (*it)->stale.store(true, std::memory_order_release);
+    s.lru.erase(it);
+    s.bytes -= size;
+    m_entries.fetch_sub(1, std::memory_order_relaxed);
+    m_bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void file_cache::invalidate(std::string_view path) {
+    // 先推进失效计数再删除，与 insert 中的检查配合
+    m_epoch.fetch_add(1);
+    shard& s = shard_of(path);
+    s.lock.lock();
+    auto it = s.index.find(path);
+    if (it != s.index.end()) {
+        erase(s, it->second);
+        m_invalidations.fetch_add(1, std::memory_order_relaxed);
+    }
+    s.lock.unlock();
+}
+
+void file_cache::flush() {
+    m_epoch.fetch_add(1);
+    for (int i = 0; i < SHARDS; ++i) {
+        shard& s = m_shards[i];
+        s.lock.lock();
+        while (!s.lru.empty()) {
+            erase(s, std::prev(s.lru.end()));
+            m_invalidations.fetch_add(1, std::memory_order_relaxed);
+        }
+        s.lock.unlock();
+    }
+}
+
+file_cache::stats file_cache::get_stats() {
+    stats st;
+    st.hits = m_hits.load(std::memory_order_relaxed);
+    st.misses = m_misses.load(std::memory_order_relaxed);
+    st.evictions = m_evictions.load(std::memory_order_relaxed);
+    st.invalidations = m_invalidations.load(std::memory_order_relaxed);
+    st.entries = m_entries.load(std::memory_order_relaxed);
+    st.bytes = m_bytes.load(std::memory_order_relaxed);
+    return st;
+}
+
+// 监视目录而不是文件本身：编辑器和部署脚本常用 rename 替换文件，文件上的监视收不到新文件的变化
+void file_cache::watch(const char* path) {
+    const char* slash = strrchr(path, '/');
+    if (!slash) {
+        return;
+    }
+    std::string dir(path, slash - path);
+
+    m_watch_lock.lock();
+    if (m_dir_wd.find(dir) == m_dir_wd.end()) {
+        int wd = inotify_add_watch(m_inotify_fd, dir.empty() ? "/" : dir.c_str(), WATCH_MASK | IN_ONLYDIR);
+        if (wd >= 0) {
+            // 同一目录的不同写法（如含 ".."）得到相同的 wd，各自记录
+            m_dir_wd[dir] = wd;
+            m_wd_dir.emplace(wd, dir);
+        }
+    }
+    m_watch_lock.unlock();
+}
+
+void* file_cache::worker(void* arg) {
+    file_cache* cache = (file_cache*)arg;
+    cache->run();
+    return cache;
+}
+
+void file_cache::run() {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (true) {
+        ssize_t len = read(m_inotify_fd, buf, sizeof(buf));
+        if (len <= 0) {
+            if (len < 0 && errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("inotify read failure, errno is:%d, file cache disabled", errno);
+            m_shard_budget = 0;
+            flush();
+            return;
+        }
+
+        for (char* p = buf; p < buf + len;) {
+            const struct inotify_event* ev = (const struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + ev->len;
+
+            // 事件队列溢出时丢失了哪些文件变化未知，全部失效
+            if (ev->mask & IN_Q_OVERFLOW) {
+                flush();
+                continue;
+            }
+            if (ev->mask & IN_IGNORED) {
+                m_watch_lock.lock();
+                auto range = m_wd_dir.equal_range(ev->wd);
+                for (auto it = range.first; it != range.second; ++it) {
+                    m_dir_wd.erase(it->second);
+                }
+                m_wd_dir.erase(ev->wd);
+                m_watch_lock.unlock();
+                continue;
+            }
+            // 目录被删除或移走，其下的文件全部失效；移走的目录撤销监视，之后按新路径重新注册
+            if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                if (ev->mask & IN_MOVE_SELF) {
+                    inotify_rm_watch(m_inotify_fd, ev->wd);
+                }
+                flush();
+                continue;
+            }
+            if (0 == ev->len) {
+                continue;
+            }
+
+            std::vector<std::string> files;
+            m_watch_lock.lock();
+            auto range = m_wd_dir.equal_range(ev->wd);
+            for (auto it = range.first; it != range.second; ++it) {
+                files.push_back(it->second + "/" + ev->name);
+            }
+            m_watch_lock.unlock();
+
+            for (size_t i = 0; i < files.size(); ++i) {
+                invalidate(files[i]);
+                // 预压缩文件变化时原文件也失效，依赖它的压缩变体和缓存响应随之重建
+                if (files[i].size() > 3 && files[i].compare(files[i].size() - 3, 3, ".gz") == 0) {
+                    invalidate(std::string_view(files[i]).substr(0, files[i].size() - 3));
+                }
+            }
+        }
+    }
+}
+
+const char* file_cache::mime_type(const char* path) {
+    static const struct {
+        const char* ext;
+        const char* type;
+    } types[] = {
+        {"html", "text/html"},
+        {"htm", "text/html"},
+        {"css", "text/css"},
+        {"js", "application/javascript"},
+        {"json", "application/json"},
+        {"txt", "text/plain"},
+        {"xml", "text/xml"},
+        {"jpg", "image/jpeg"},
+        {"jpeg", "image/jpeg"},
+        {"png", "image/png"},
+        {"gif", "image/gif"},
+        {"ico", "image/x-icon"},
+        {"svg", "image/svg+xml"},
+        {"webp", "image/webp"},
+        {"mp4", "video/mp4"},
+        {"webm", "video/webm"},
+        {"mp3", "audio/mpeg"},
+        {"pdf", "application/pdf"},
+    };
+
+    const char* dot = strrchr(path, '.');
+    if (!dot || strchr(dot, '/')) {
+        return "application/octet-stream";
+    }
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+        if (strcasecmp(dot + 1, types[i].ext) == 0) {
+            return types[i].type;
+        }
+    }
+    return "application/octet-stream";
+}
@@ -0,0 +1,168 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "../lock/locker.h"
+
+/**
+ * @brief 一个打开的静态文件
+ *
+ * 创建后不再修改，可被多个连接同时引用；最后一个引用释放时才解除映射、关闭描述符，
+ * 因此被淘汰或失效的文件不会影响正在发送它的连接
+ */
+struct file_entry {
+    std::string path;
+    int fd;              // sendfile 模式下保留的描述符，mmap 模式为 -1
+    char* addr;          // mmap 模式下的映射地址，sendfile 模式或空文件为 NULL
+    struct stat st;
+    const char* mime;        // 按扩展名得到的 MIME 类型
+    const char* encoding;    // 内容编码，原文件为 NULL，压缩变体为 "gzip"
+    bool vary;               // 响应随 Accept-Encoding 变化，需要带 Vary 响应头
+    std::string etag;        // 强 ETag，由 inode、大小和纳秒精度的修改时间生成，含引号
+    std::string validators;  // 预先生成的 ETag、Last-Modified 与 Vary 响应头，304 与 206 也使用
+    std::string header;      // 预先生成的 Content-Length、Content-Type、Content-Encoding、Accept-Ranges 响应头，后接 validators
+    std::shared_ptr<const file_entry> source;  // 内容借用自的缓存项（预压缩的 .gz 文件），此时 fd 与 addr 不归本项释放
+
+    mutable std::atomic<bool> stale;  // 已被淘汰或失效，由它生成的缓存响应随之作废
+
+    file_entry() : fd(-1), addr(NULL), mime(NULL), encoding(NULL), vary(false), stale(false) {}
+    ~file_entry();
+};
+
+typedef std::shared_ptr<const file_entry> file_ref;
+
+/**
+ * @brief 静态文件缓存
+ *
+ * 以解析后的路径为键，缓存打开的描述符或映射、stat 结果、MIME 类型和预生成的响应头，
+ * 命中时不再有 stat / open / mmap / close。按路径哈希分为多个分片，各自加锁并维护 LRU 链表，
+ * 总字节数超过预算时淘汰最久未用的文件。inotify 监视缓存文件所在的目录，文件被修改、替换或删除时立即失效。
+ */
+class file_cache {
+   public:
+    /** @brief 查找结果 */
+    enum result { FILE_OK = 0, FILE_MISSING, FILE_FORBIDDEN, FILE_DIRECTORY };
+
+    /** @brief 计数器快照，用于确定缓存大小 */
+    struct stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        uint64_t invalidations;
+        uint64_t entries;
+        uint64_t bytes;
+    };
+
+    static file_cache* get_instance() {
+        static file_cache instance;
+        return &instance;
+    }
+
+    /**
+     * @brief 初始化缓存
+     *
+     * @param budget    缓存文件的总字节数上限，0 表示不缓存，每次请求都重新打开文件
+     * @param sendfile  为 true 时保留描述符供 sendfile 使用，否则映射文件内容
+     * @param close_log 是否关闭日志
+     */
+    void init(size_t budget, bool sendfile, int close_log);
+
+    /**
+     * @brief 取得路径对应的文件
+     *
+     * 只有其他人可读的普通文件才会打开；超过单个分片预算的文件不进入缓存，照常打开后交给调用方独占
+     *
+     * @param path 文件的完整路径
+     * @param ref  输出文件引用，只在返回 FILE_OK 时有效
+     */
+    result acquire(const char* path, file_ref& ref);
+
+    /** @brief 使路径对应的缓存失效 */
+    void invalidate(std::string_view path);
+
+    /** @brief 清空缓存 */
+    void flush();
+
+    stats get_stats();
+
+    /** @brief 是否启用了缓存，未启用时文件不会失效，依赖它的响应缓存与压缩变体缓存也不启用 */
+    bool enabled() const { return m_shard_budget > 0; }
+
+    /** @brief 文件以描述符（sendfile）而不是映射提供 */
+    bool sendfile() const { return m_sendfile; }
+
+    /** @brief 由 etag、大小、MIME 类型、内容编码和 vary 生成 validators 与 header，Last-Modified 取 mtime */
+    static void make_headers(file_entry& entry, time_t mtime);
+
+    /** @brief 按扩展名返回 MIME 类型，未知扩展名为 application/octet-stream */
+    static const char* mime_type(const char* path);
+
+   private:
+    file_cache();
+    ~file_cache() {}
+
+    /** @brief 分片数，按路径哈希选择 */
+    static const int SHARDS = 16;
+
+    /** @brief 每个分片最多缓存的文件数，限制常驻的描述符与映射数量 */
+    static const int MAX_SHARD_ENTRIES = 256;
+
+    struct shard {
+        locker lock;
+        std::list<file_ref> lru;  // 表头为最近使用
+        std::unordered_map<std::string_view, std::list<file_ref>::iterator> index;  // 键指向 file_entry::path
+        size_t bytes;
+        shard() : bytes(0) {}
+    };
+
+    shard& shard_of(std::string_view path) { return m_shards[std::hash<std::string_view>()(path) % SHARDS]; }
+
+    /** @brief 打开文件并生成缓存项 */
+    result load(const char* path, file_ref& ref);
+
+    /** @brief 把新打开的文件放入缓存，期间有文件失效时放弃，同一路径已被其它线程放入时改用已有的 */
+    void insert(file_ref& ref, uint64_t epoch);
+
+    /** @brief 从分片中删除一项，调用方持有分片锁 */
+    void erase(shard& s, std::list<file_ref>::iterator it);
+
+    /** @brief 为文件所在目录注册 inotify 监视 */
+    void watch(const char* path);
+
+    static void* worker(void* arg);
+    void run();
+
+   private:
+    shard m_shards[SHARDS];
+    std::atomic<size_t> m_shard_budget;  // 每个分片的字节数上限，为 0 时不缓存
+    bool m_sendfile;
+    int m_close_log;
+
+    std::atomic<uint64_t> m_epoch;  // 每次失效加一，打开文件期间有失效发生时不放入缓存
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+    std::atomic<uint64_t> m_evictions;
+    std::atomic<uint64_t> m_invalidations;
+    std::atomic<uint64_t> m_entries;
+    std::atomic<uint64_t> m_bytes;
+
+    int m_inotify_fd;
+    pthread_t m_thread;
+    locker m_watch_lock;
+    std::map<std::string, int> m_dir_wd;  // 已监视的目录
+    std::multimap<int, std::string> m_wd_dir;  // 同一目录的不同写法共用一个 wd
+};
+
+#endif  // !FILE_CACHE_H
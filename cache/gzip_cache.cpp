@@ -0,0 +1,196 @@
+#include "gzip_cache.h"
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <vector>
+
+void gzip_cache::init(size_t budget) { m_budget = budget; }
+
+bool gzip_cache::negotiable(const char* mime, off_t size) {
+    if (size < MIN_SIZE) {
+        return false;
+    }
+    // 图片、音视频和 PDF 本身已经压缩过
+    return strncmp(mime, "text/", 5) == 0 || strcmp(mime, "application/javascript") == 0 ||
+           strcmp(mime, "application/json") == 0 || strcmp(mime, "image/svg+xml") == 0;
+}
+
+file_ref gzip_cache::acquire(const file_ref& file) {
+    // 没有文件缓存就无从得知文件变化，只使用预压缩文件
+    if (0 == m_budget || !file_cache::get_instance()->enabled()) {
+        return load_sibling(*file);
+    }
+
+    m_lock.lock();
+    auto it = m_index.find(file->path);
+    if (it != m_index.end()) {
+        const entry& e = *it->second;
+        if (valid(e, file)) {
+            m_lru.splice(m_lru.begin(), m_lru, it->second);
+            file_ref variant = e.variant;
+            m_lock.unlock();
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return variant;
+        }
+        erase(it->second);
+    }
+    m_lock.unlock();
+
+    entry e;
+    e.path = file->path;
+    e.source_etag = file->etag;
+    e.bytes = 0;
+    e.variant = load_sibling(*file);
+    if (e.variant) {
+        e.source_file = file;
+        m_precompressed.fetch_add(1, std::memory_order_relaxed);
+    } else if ((size_t)file->st.st_size <= m_budget) {
+        e.variant = compress(*file);
+        m_compressions.fetch_add(1, std::memory_order_relaxed);
+        if (e.variant) {
+            e.bytes = e.variant->st.st_size;
+        }
+    }
+    file_ref variant = e.variant;
+
+    m_lock.lock();
+    // 其它线程可能已放入同一文件的变体，以后放入的为准
+    it = m_index.find(file->path);
+    if (it != m_index.end()) {
+        erase(it->second);
+    }
+    while (!m_lru.empty() && (m_bytes + e.bytes > m_budget || m_index.size() >= (size_t)MAX_ENTRIES)) {
+        erase(std::prev(m_lru.end()));
+    }
+    if (m_bytes + e.bytes <= m_budget) {
+        m_lru.push_front(std::move(e));
+        m_index.emplace(std::string_view(m_lru.front().path), m_lru.begin());
+        m_bytes += m_lru.front().bytes;
+    }
+    m_lock.unlock();
+    return variant;
+}
+
+// 即时压缩的变体只取决于原文件内容，ETag 相同即有效。预压缩文件变化时文件缓存会连同原文件一起失效，
+// 因此来自预压缩文件的变体还要求原文件仍是同一个缓存项，且预压缩文件未被淘汰或失效
+bool gzip_cache::valid(const entry& e, const file_ref& file) {
+    if (e.source_etag != file->etag) {
+        return false;
+    }
+    if (!e.variant || !e.variant->source) {
+        return true;
+    }
+    return e.source_file.lock() == file && !e.variant->source->stale.load(std::memory_order_acquire);
+}
+
+file_ref gzip_cache::load_sibling(const file_entry& file) {
+    std::string path = file.path + ".gz";
+    file_ref gz;
+    if (file_cache::get_instance()->acquire(path.c_str(), gz) != file_cache::FILE_OK || 0 == gz->st.st_size) {
+        return file_ref();
+    }
+    // 比原文件旧的预压缩文件内容可能已经过时
+    const struct timespec& a = gz->st.st_mtim;
+    const struct timespec& b = file.st.st_mtim;
+    if (a.tv_sec < b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec)) {
+        return file_ref();
+    }
+
+    std::shared_ptr<file_entry> variant = std::make_shared<file_entry>();
+    variant->path = file.path;
+    variant->fd = gz->fd;
+    variant->addr = gz->addr;
+    variant->st = gz->st;
+    variant->mime = file.mime;
+    variant->encoding = "gzip";
+    variant->vary = true;
+    variant->etag = gz->etag;
+    file_cache::make_headers(*variant, file.st.st_mtime);
+    variant->source = std::move(gz);
+    return variant;
+}
+
+file_ref gzip_cache::compress(const file_entry& file) {
+    // 原文件内容取自映射；零拷贝模式下文件没有映射，读一次描述符
+    const char* data = file.addr;
+    std::vector<char> buf;
+    if (!data) {
+        buf.resize(file.st.st_size);
+        if (pread(file.fd, buf.data(), buf.size(), 0) != (ssize_t)buf.size()) {
+            return file_ref();
+        }
+        data = buf.data();
+    }
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // windowBits 加 16 生成 gzip 格式而不是 zlib 格式
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return file_ref();
+    }
+    std::vector<char> out(deflateBound(&zs, file.st.st_size));
+    zs.next_in = (Bytef*)data;
+    zs.avail_in = file.st.st_size;
+    zs.next_out = (Bytef*)out.data();
+    zs.avail_out = out.size();
+    int ret = deflate(&zs, Z_FINISH);
+    size_t len = zs.total_out;
+    deflateEnd(&zs);
+    if (ret != Z_STREAM_END || len >= (size_t)file.st.st_size) {
+        return file_ref();
+    }
+
+    // 压缩结果写入 memfd，之后与磁盘上的文件一样映射或用 sendfile 发送
+    int fd = memfd_create("gzip", MFD_CLOEXEC);
+    if (fd < 0) {
+        return file_ref();
+    }
+    if (write(fd, out.data(), len) != (ssize_t)len) {
+        close(fd);
+        return file_ref();
+    }
+
+    std::shared_ptr<file_entry> variant = std::make_shared<file_entry>();
+    variant->path = file.path;
+    variant->st = file.st;
+    variant->st.st_size = len;
+    if (file_cache::get_instance()->sendfile()) {
+        variant->fd = fd;
+    } else {
+        void* addr = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (MAP_FAILED == addr) {
+            return file_ref();
+        }
+        variant->addr = (char*)addr;
+    }
+    variant->mime = file.mime;
+    variant->encoding = "gzip";
+    variant->vary = true;
+    // 不同编码的表示须有不同的强 ETag
+    variant->etag = file.etag.substr(0, file.etag.size() - 1) + "-gz\"";
+    file_cache::make_headers(*variant, file.st.st_mtime);
+    return variant;
+}
+
+void gzip_cache::erase(std::list<entry>::iterator it) {
+    // 索引的键指向表项中的路径，先删索引
+    m_index.erase(it->path);
+    m_bytes -= it->bytes;
+    m_lru.erase(it);
+}
+
+gzip_cache::stats gzip_cache::get_stats() {
+    stats st;
+    st.hits = m_hits.load(std::memory_order_relaxed);
+    st.compressions = m_compressions.load(std::memory_order_relaxed);
+    st.precompressed = m_precompressed.load(std::memory_order_relaxed);
+    m_lock.lock();
+    st.entries = m_index.size();
+    st.bytes = m_bytes;
+    m_lock.unlock();
+    return st;
+}
@@ -0,0 +1,98 @@
+#ifndef GZIP_CACHE_H
+#define GZIP_CACHE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "../lock/locker.h"
+#include "file_cache.h"
+
+/**
+ * @brief 静态文件的 gzip 压缩变体缓存
+ *
+ * 客户端接受 gzip 时，优先使用磁盘上不旧于原文件的 .gz 同名文件（由文件缓存打开并监视）；
+ * 没有时用 zlib 压缩一次，结果放入 memfd，与普通文件一样映射或由 sendfile 发送。
+ * 以原文件路径为键，原文件的 ETag（inode、大小与修改时间）变化或预压缩文件失效时重新生成；
+ * 压缩结果的总字节数有预算，超出时淘汰最久未用的变体。
+ */
+class gzip_cache {
+   public:
+    /** @brief 小于此大小的文件不协商编码，压缩收益抵不过 gzip 头部和 CPU 开销 */
+    static const int MIN_SIZE = 256;
+
+    /** @brief 最多缓存的变体数 */
+    static const int MAX_ENTRIES = 1024;
+
+    /** @brief 计数器快照 */
+    struct stats {
+        uint64_t hits;
+        uint64_t compressions;
+        uint64_t precompressed;
+        uint64_t entries;
+        uint64_t bytes;
+    };
+
+    static gzip_cache* get_instance() {
+        static gzip_cache instance;
+        return &instance;
+    }
+
+    /**
+     * @brief 初始化缓存
+     *
+     * @param budget 即时压缩结果的总字节数上限；文件缓存未启用或为 0 时不做即时压缩，只使用预压缩文件
+     */
+    void init(size_t budget);
+
+    /** @brief 该类型和大小的文件是否按 Accept-Encoding 协商编码 */
+    static bool negotiable(const char* mime, off_t size);
+
+    /** @brief 取得原文件的 gzip 变体，没有预压缩文件且不能即时压缩、或压缩后不更小时返回空引用 */
+    file_ref acquire(const file_ref& file);
+
+    stats get_stats();
+
+   private:
+    gzip_cache() : m_budget(0), m_bytes(0), m_hits(0), m_compressions(0), m_precompressed(0) {}
+    ~gzip_cache() {}
+
+    struct entry {
+        std::string path;
+        std::string source_etag;  // 生成变体时原文件的 ETag
+        std::weak_ptr<const file_entry> source_file;  // 来自预压缩文件时记录原文件的缓存项
+        file_ref variant;         // 为空表示压缩后不更小，不再尝试
+        size_t bytes;             // 计入预算的字节数，预算外的预压缩文件为 0
+    };
+
+    /** @brief 表项对原文件是否仍然有效 */
+    static bool valid(const entry& e, const file_ref& file);
+
+    /** @brief 打开不旧于原文件的 .gz 同名文件 */
+    file_ref load_sibling(const file_entry& file);
+
+    /** @brief 用 zlib 压缩原文件，压缩后不更小时返回空引用 */
+    file_ref compress(const file_entry& file);
+
+    /** @brief 删除一项，调用方持有锁 */
+    void erase(std::list<entry>::iterator it);
+
+   private:
+    locker m_lock;
+    std::list<entry> m_lru;  // 表头为最近使用
+    std::unordered_map<std::string_view, std::list<entry>::iterator> m_index;  // 键指向 entry::path
+    size_t m_budget;
+    size_t m_bytes;
+
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_compressions;
+    std::atomic<uint64_t> m_precompressed;
+};
+
+#endif  // !GZIP_CACHE_H
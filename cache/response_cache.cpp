@@ -0,0 +1,113 @@
+#include "response_cache.h"
+
+#include <unistd.h>
+
+#include <vector>
+
+#include "gzip_cache.h"
+
+response_ref response_cache::lookup(std::string_view url) {
+    if (!file_cache::get_instance()->enabled()) {
+        return response_ref();
+    }
+
+    response_ref resp;
+    m_lock.lock();
+    // C++17 的 unordered_map 不支持异构查找，URL 很短，临时 string 在小字符串缓冲区内
+    auto it = m_map.find(std::string(url));
+    if (it != m_map.end()) {
+        if (it->second->file->stale.load(std::memory_order_acquire)) {
+            m_map.erase(it);
+        } else {
+            resp = it->second;
+        }
+    }
+    m_lock.unlock();
+
+    if (resp) {
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+    }
+    return resp;
+}
+
+void response_cache::insert(std::string_view url, const file_ref& file, const std::string& cache_control) {
+    if (!file_cache::get_instance()->enabled() || file->st.st_size > MAX_BODY) {
+        return;
+    }
+
+    std::string key(url);
+    m_lock.lock();
+    auto it = m_map.find(key);
+    bool exists = it != m_map.end() && !it->second->file->stale.load(std::memory_order_acquire);
+    m_lock.unlock();
+    if (exists) {
+        return;
+    }
+
+    std::shared_ptr<cached_response> resp = std::make_shared<cached_response>();
+    if (!build(resp->full[0], resp->not_modified[0], *file, cache_control)) {
+        return;
+    }
+    if (file->vary) {
+        resp->gzip = gzip_cache::get_instance()->acquire(file);
+        if (resp->gzip && !build(resp->full[1], resp->not_modified[1], *resp->gzip, cache_control)) {
+            return;
+        }
+    }
+    resp->file = file;
+
+    m_lock.lock();
+    if ((int)m_map.size() >= MAX_ENTRIES) {
+        // 表满时先清掉已作废的响应，仍然满就不再缓存
+        for (auto i = m_map.begin(); i != m_map.end();) {
+            if (i->second->file->stale.load(std::memory_order_acquire)) {
+                i = m_map.erase(i);
+            } else {
+                ++i;
+            }
+        }
+    }
+    if ((int)m_map.size() < MAX_ENTRIES || m_map.count(key)) {
+        m_map[key] = std::move(resp);
+    }
+    m_lock.unlock();
+}
+
+bool response_cache::build(std::string* full, std::string* not_modified, const file_entry& file,
+                           const std::string& cache_control) {
+    // 正文取自映射；零拷贝模式下文件没有映射，读一次描述符
+    const char* body = file.addr;
+    std::vector<char> buf;
+    if (!body) {
+        buf.resize(file.st.st_size);
+        if (pread(file.fd, buf.data(), buf.size(), 0) != (ssize_t)buf.size()) {
+            return false;
+        }
+        body = buf.data();
+    }
+
+    const char* connection[2] = {"close", "keep-alive"};
+    for (int i = 0; i < 2; ++i) {
+        build(full[i], file, cache_control, connection[i], body);
+        build(not_modified[i], file, cache_control, connection[i], NULL);
+    }
+    return true;
+}
+
+// 与常规路径 process_write 在状态行和 Date 之后生成的字节完全一致
+void response_cache::build(std::string& out, const file_entry& file, const std::string& cache_control,
+                           const char* connection, const char* body) {
+    if (body) {
+        out.reserve(32 + file.header.size() + cache_control.size() + file.st.st_size);
+        out.append(file.header);
+    } else {
+        out.append(file.validators);
+    }
+    out.append(cache_control);
+    out.append("Connection:").append(connection).append("\r\n\r\n");
+    if (body) {
+        out.append(body, file.st.st_size);
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "../lock/locker.h"
+#include "file_cache.h"
+
+/**
+ * @brief 一个小文件的完整响应
+ *
+ * 第一维下标 0 为原文件，1 为 gzip 变体（gzip 为空时没有）；第二维下标 0 为 Connection:close，1 为 Connection:keep-alive
+ */
+struct cached_response {
+    std::string full[2][2];          // 200 响应 Date 之后的响应头和正文，状态行与 Date 由发送方生成
+    std::string not_modified[2][2];  // If-None-Match 命中时的 304 响应 Date 之后的响应头
+    file_ref file;                   // 生成响应的文件，它离开文件缓存时响应作废
+    file_ref gzip;                   // 文件的 gzip 变体，文件不协商编码或压缩无收益时为空
+};
+
+typedef std::shared_ptr<const cached_response> response_ref;
+
+/**
+ * @brief 小文件的完整响应缓存
+ *
+ * 以请求行中的 URL 为键，保存常规路径生成过的 200 响应中除状态行与 Date 外的全部字节。事件循环读到可以直接应答的 GET 时
+ * 在本线程查表发送，不经过线程池、请求解析、do_request 和 vsnprintf。
+ * 响应的有效期跟随文件缓存中的文件：文件被修改、替换、删除或淘汰后，下一次查找时丢弃响应，回到常规路径重新生成。
+ */
+class response_cache {
+   public:
+    /** @brief 只缓存正文不超过此大小的文件 */
+    static const int MAX_BODY = 4096;
+
+    /** @brief 最多缓存的响应数 */
+    static const int MAX_ENTRIES = 256;
+
+    static response_cache* get_instance() {
+        static response_cache instance;
+        return &instance;
+    }
+
+    /** @brief 按 URL 查找响应，未命中或已作废时返回空引用 */
+    response_ref lookup(std::string_view url);
+
+    /**
+     * @brief 常规路径遇到小文件的 GET 时调用，由文件生成完整响应并缓存，需要协商编码的文件同时生成 gzip 变体的响应
+     *
+     * @param cache_control 该 URL 的 Cache-Control 响应头，没有时为空串
+     */
+    void insert(std::string_view url, const file_ref& file, const std::string& cache_control);
+
+    uint64_t hits() const { return m_hits.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return m_misses.load(std::memory_order_relaxed); }
+
+   private:
+    response_cache() : m_hits(0), m_misses(0) {}
+    ~response_cache() {}
+
+    /** @brief 由文件生成两种 Connection 取值的 200 与 304 响应 */
+    static bool build(std::string* full, std::string* not_modified, const file_entry& file,
+                      const std::string& cache_control);
+
+    /** @brief 生成一种 Connection 取值的完整响应，body 为 NULL 时生成 304 */
+    static void build(std::string& out, const file_entry& file, const std::string& cache_control,
+                      const char* connection, const char* body);
+
+   private:
+    locker m_lock;
+    std::unordered_map<std::string, response_ref> m_map;
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+};
+
+#endif  // !RESPONSE_CACHE_H
@@ -4,7 +4,7 @@ Config::Config() {
     // 端口号，默认 9006
     PORT = 9006;
 
-    // 日志写入方式，默认同步
+    // 日志写入方式，默认同步，1 为异步，2 为异步二进制（用 logdecode 还原）
     LOGWrite = 0;
 
     // 触发组合模式，默认 listenfd LT + connfd LT
@@ -30,11 +30,50 @@ Config::Config() {
 
     // 并发模型，默认是 proactor
     actor_model = 0;
+
+    // 从 reactor 数量，默认 0 即单 reactor，主线程处理所有事件
+    reactor_num = 0;
+
+    // 新连接分发策略，默认轮询，1 为最少连接
+    dispatch_mode = 0;
+
+    // SO_REUSEPORT 分片监听，默认不使用，需配合从 reactor
+    reuseport = 0;
+
+    // listen 队列长度，默认 1024
+    backlog = 1024;
+
+    // I/O 后端，默认 epoll，1 为 io_uring（内核不支持时自动回退到 epoll）
+    io_backend = 0;
+
+    // 线程池调度模式，默认共享队列，1 为每线程本地队列 + 工作窃取
+    steal = 0;
+
+    // 静态文件发送方式，默认 mmap + writev，1 为 sendfile 零拷贝（io_uring 后端不支持，仍用 mmap）
+    zerocopy = 0;
+
+    // 静态文件缓存大小，默认 64MB，0 为不缓存
+    cache_size = 64;
+
+    // 按路径前缀配置的 Cache-Control，默认不发送，形如 "/=no-cache;/static/=max-age=86400"
+    cache_control = "";
+
+    // 运行日志的最低级别，默认 1 即 info，0 为 debug（含每个请求的请求头与响应头），2 为 warn，3 为 error
+    log_level = 1;
+
+    // 访问日志采样率，默认 0 不写访问日志，N 为每 N 个响应记录一个
+    access_sample = 0;
+
+    // 日志切分、压缩与保留策略，默认只按天和行数切分，形如 "size=64;gzip;keep=30;total=1024"
+    log_rotate = "";
+
+    // 异步日志的后台线程跟不上时，默认 0 等待缓冲区归还，1 丢弃 debug 与 info 日志（warn 与 error 总是等待）
+    log_drop = 0;
 }
 
 void Config::parse_arg(int argc, char* argv[]) {
     int opt;
-    const char* str = "p:l:m:o:s:t:c:a";
+    const char* str = "p:l:m:o:s:t:c:a:r:d:u:b:i:w:z:f:e:v:x:g:k:";
     while ((opt = getopt(argc, argv, str)) != -1) {
         switch (opt) {
             case 'p': {
@@ -69,6 +108,58 @@ void Config::parse_arg(int argc, char* argv[]) {
                 actor_model = atoi(optarg);
                 break;
             }
+            case 'r': {
+                reactor_num = atoi(optarg);
+                break;
+            }
+            case 'd': {
+                dispatch_mode = atoi(optarg);
+                break;
+            }
+            case 'u': {
+                reuseport = atoi(optarg);
+                break;
+            }
+            case 'b': {
+                backlog = atoi(optarg);
+                break;
+            }
+            case 'i': {
+                io_backend = atoi(optarg);
+                break;
+            }
+            case 'w': {
+                steal = atoi(optarg);
+                break;
+            }
+            case 'z': {
+                zerocopy = atoi(optarg);
+                break;
+            }
+            case 'f': {
+                cache_size = atoi(optarg);
+                break;
+            }
+            case 'e': {
+                cache_control = optarg;
+                break;
+            }
+            case 'v': {
+                log_level = atoi(optarg);
+                break;
+            }
+            case 'x': {
+                access_sample = atoi(optarg);
+                break;
+            }
+            case 'g': {
+                log_rotate = optarg;
+                break;
+            }
+            case 'k': {
+                log_drop = atoi(optarg);
+                break;
+            }
             default:
                 break;
         }
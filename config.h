@@ -39,6 +39,45 @@ public:
 
     // 并发模型选择
     int actor_model;
+
+    // 从 reactor 数量
+    int reactor_num;
+
+    // 新连接分发策略
+    int dispatch_mode;
+
+    // 每个从 reactor 独立的 SO_REUSEPORT 监听 socket
+    int reuseport;
+
+    // listen 队列长度
+    int backlog;
+
+    // I/O 后端
+    int io_backend;
+
+    // 线程池调度模式
+    int steal;
+
+    // 静态文件发送方式
+    int zerocopy;
+
+    // 静态文件缓存大小（MB）
+    int cache_size;
+
+    // 按路径前缀配置的 Cache-Control
+    string cache_control;
+
+    // 运行日志的最低级别
+    int log_level;
+
+    // 访问日志采样率
+    int access_sample;
+
+    // 日志切分、压缩与保留策略
+    string log_rotate;
+
+    // 后台线程跟不上时是否丢弃 debug 与 info 日志
+    int log_drop;
 };
 
 #endif // !CONFIG_H
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef CACHE_POLICY_H
+#define CACHE_POLICY_H
+
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 按 URL 路径前缀配置的 Cache-Control
+ *
+ * 规则形如 "/=no-cache;/test1.jpg=public, max-age=86400"，以 ';' 分隔，每条在第一个 '=' 处分为前缀和指令，
+ * 按最长前缀匹配。启动时解析一次，之后只读，工作线程并发查找无需加锁
+ */
+class cache_policy {
+   public:
+    /** @brief 单条指令的最大长度，保证任一响应的响应头都能放进 http_conn::MAX_RESPONSE_HEAD */
+    static const size_t MAX_DIRECTIVE = 128;
+
+    static cache_policy* get_instance() {
+        static cache_policy instance;
+        return &instance;
+    }
+
+    /** @brief 解析规则，格式错误或指令超过 MAX_DIRECTIVE 的规则被忽略，此时返回 false */
+    bool init(const char* rules) {
+        bool ok = true;
+        m_rules.clear();
+        const char* p = rules;
+        while (p && *p) {
+            const char* end = strchr(p, ';');
+            if (!end) {
+                end = p + strlen(p);
+            }
+            const char* eq = (const char*)memchr(p, '=', end - p);
+            if (eq && eq > p && eq + 1 < end && (size_t)(end - eq - 1) <= MAX_DIRECTIVE) {
+                m_rules.emplace_back(std::string(p, eq - p), "Cache-Control:" + std::string(eq + 1, end) + "\r\n");
+            } else {
+                ok = false;
+            }
+            p = *end ? end + 1 : end;
+        }
+        // 长的前缀在前，第一个匹配的就是最长前缀
+        std::stable_sort(m_rules.begin(), m_rules.end(),
+                         [](const std::pair<std::string, std::string>& a,
+                            const std::pair<std::string, std::string>& b) { return a.first.size() > b.first.size(); });
+        return ok;
+    }
+
+    /** @brief 返回匹配的 Cache-Control 响应头（含 \r\n），没有匹配的规则时返回空串 */
+    const std::string& lookup(std::string_view path) const {
+        for (size_t i = 0; i < m_rules.size(); ++i) {
+            if (path.substr(0, m_rules[i].first.size()) == m_rules[i].first) {
+                return m_rules[i].second;
+            }
+        }
+        return m_empty;
+    }
+
+   private:
+    cache_policy() {}
+
+    std::vector<std::pair<std::string, std::string>> m_rules;  // 前缀与预先生成的响应头
+    std::string m_empty;
+};
+
+#endif  // !CACHE_POLICY_H
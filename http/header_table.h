@@ -0,0 +1,193 @@
+#ifndef HEADER_TABLE_H
+#define HEADER_TABLE_H
+
+#include <stdint.h>
+#include <strings.h>
+
+#include <string_view>
+
+/** @brief 标准请求头编号，与 k_header_names 一一对应 */
+enum http_header_id {
+    HDR_ACCEPT = 0,
+    HDR_ACCEPT_CHARSET,
+    HDR_ACCEPT_ENCODING,
+    HDR_ACCEPT_LANGUAGE,
+    HDR_AUTHORIZATION,
+    HDR_CACHE_CONTROL,
+    HDR_CONNECTION,
+    HDR_CONTENT_ENCODING,
+    HDR_CONTENT_LENGTH,
+    HDR_CONTENT_TYPE,
+    HDR_COOKIE,
+    HDR_DATE,
+    HDR_DNT,
+    HDR_EXPECT,
+    HDR_FORWARDED,
+    HDR_FROM,
+    HDR_HOST,
+    HDR_IF_MATCH,
+    HDR_IF_MODIFIED_SINCE,
+    HDR_IF_NONE_MATCH,
+    HDR_IF_RANGE,
+    HDR_IF_UNMODIFIED_SINCE,
+    HDR_KEEP_ALIVE,
+    HDR_MAX_FORWARDS,
+    HDR_ORIGIN,
+    HDR_PRAGMA,
+    HDR_PRIORITY,
+    HDR_PROXY_AUTHORIZATION,
+    HDR_PROXY_CONNECTION,
+    HDR_RANGE,
+    HDR_REFERER,
+    HDR_SEC_CH_UA,
+    HDR_SEC_CH_UA_MOBILE,
+    HDR_SEC_CH_UA_PLATFORM,
+    HDR_SEC_FETCH_DEST,
+    HDR_SEC_FETCH_MODE,
+    HDR_SEC_FETCH_SITE,
+    HDR_SEC_FETCH_USER,
+    HDR_TE,
+    HDR_TRAILER,
+    HDR_TRANSFER_ENCODING,
+    HDR_UPGRADE,
+    HDR_UPGRADE_INSECURE_REQUESTS,
+    HDR_USER_AGENT,
+    HDR_VIA,
+    HDR_WARNING,
+    HDR_X_FORWARDED_FOR,
+    HDR_X_FORWARDED_HOST,
+    HDR_X_FORWARDED_PROTO,
+    HDR_X_REAL_IP,
+    HDR_X_REQUESTED_WITH,
+    HDR_COUNT,
+    HDR_UNKNOWN = -1
+};
+
+constexpr std::string_view k_header_names[] = {
+    "Accept",
+    "Accept-Charset",
+    "Accept-Encoding",
+    "Accept-Language",
+    "Authorization",
+    "Cache-Control",
+    "Connection",
+    "Content-Encoding",
+    "Content-Length",
+    "Content-Type",
+    "Cookie",
+    "Date",
+    "DNT",
+    "Expect",
+    "Forwarded",
+    "From",
+    "Host",
+    "If-Match",
+    "If-Modified-Since",
+    "If-None-Match",
+    "If-Range",
+    "If-Unmodified-Since",
+    "Keep-Alive",
+    "Max-Forwards",
+    "Origin",
+    "Pragma",
+    "Priority",
+    "Proxy-Authorization",
+    "Proxy-Connection",
+    "Range",
+    "Referer",
+    "Sec-CH-UA",
+    "Sec-CH-UA-Mobile",
+    "Sec-CH-UA-Platform",
+    "Sec-Fetch-Dest",
+    "Sec-Fetch-Mode",
+    "Sec-Fetch-Site",
+    "Sec-Fetch-User",
+    "TE",
+    "Trailer",
+    "Transfer-Encoding",
+    "Upgrade",
+    "Upgrade-Insecure-Requests",
+    "User-Agent",
+    "Via",
+    "Warning",
+    "X-Forwarded-For",
+    "X-Forwarded-Host",
+    "X-Forwarded-Proto",
+    "X-Real-IP",
+    "X-Requested-With",
+};
+
+static_assert(sizeof(k_header_names) / sizeof(k_header_names[0]) == HDR_COUNT, "header name table out of sync");
+
+/** @brief 完美哈希表的槽数 */
+const uint32_t HEADER_SLOTS = 512;
+
+/** @brief 带种子的 FNV-1a，每个字节先 | 0x20：对字母相当于转小写，对 '-' 和数字不变，因此大小写不敏感 */
+constexpr uint32_t header_hash(std::string_view name, uint32_t seed) {
+    uint32_t h = seed;
+    for (size_t i = 0; i < name.size(); ++i) {
+        h ^= (unsigned char)(name[i] | 0x20);
+        h *= 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+constexpr bool header_seed_collides(uint32_t seed) {
+    bool used[HEADER_SLOTS] = {};
+    for (int i = 0; i < HDR_COUNT; ++i) {
+        uint32_t slot = header_hash(k_header_names[i], seed) & (HEADER_SLOTS - 1);
+        if (used[slot]) {
+            return true;
+        }
+        used[slot] = true;
+    }
+    return false;
+}
+
+/** @brief 从 FNV 初始值起逐个尝试种子，直到所有标准头名落在互不冲突的槽中 */
+constexpr uint32_t header_find_seed() {
+    uint32_t seed = 2166136261u;
+    while (header_seed_collides(seed)) {
+        ++seed;
+    }
+    return seed;
+}
+
+struct header_slots {
+    signed char id[HEADER_SLOTS];
+};
+
+constexpr header_slots header_build_slots(uint32_t seed) {
+    header_slots slots = {};
+    for (uint32_t i = 0; i < HEADER_SLOTS; ++i) {
+        slots.id[i] = -1;
+    }
+    for (int i = 0; i < HDR_COUNT; ++i) {
+        slots.id[header_hash(k_header_names[i], seed) & (HEADER_SLOTS - 1)] = (signed char)i;
+    }
+    return slots;
+}
+
+/**
+ * @brief 编译期生成的请求头名完美哈希表
+ *
+ * 种子与槽表都在编译期算出，查找时只需一次哈希和一次大小写不敏感的比较
+ */
+class header_table {
+   public:
+    /** @brief 按名称查找标准请求头编号，不是标准请求头时返回 HDR_UNKNOWN */
+    static http_header_id lookup(std::string_view name) {
+        int id = k_slots.id[header_hash(name, k_seed) & (HEADER_SLOTS - 1)];
+        if (id < 0 || k_header_names[id].size() != name.size() ||
+            strncasecmp(k_header_names[id].data(), name.data(), name.size()) != 0) {
+            return HDR_UNKNOWN;
+        }
+        return (http_header_id)id;
+    }
+
+   private:
+    static constexpr uint32_t k_seed = header_find_seed();
+    static constexpr header_slots k_slots = header_build_slots(k_seed);
+};
+
+#endif  // !HEADER_TABLE_H
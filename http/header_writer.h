@@ -0,0 +1,97 @@
+#ifndef HEADER_WRITER_H
+#define HEADER_WRITER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <string_view>
+
+/**
+ * @brief 生成响应头所用的预先拼好的片段，代替逐个字段的 vsnprintf
+ *
+ * 状态行在编译期拼好；整数由两位一组的查表转换；Date 响应头按线程缓存，每秒最多格式化一次。
+ */
+class header_writer {
+   public:
+    /** @brief 十进制整数最多 20 位 */
+    static const int MAX_UINT_DIGITS = 20;
+
+    /** @brief 取得完整的状态行（含 \r\n），未知状态码返回空视图 */
+    static std::string_view status_line(int status) {
+#define STATUS_LINE(code, title) \
+    { code, std::string_view("HTTP/1.1 " #code " " title "\r\n") }
+        static const struct {
+            int status;
+            std::string_view line;
+        } lines[] = {
+            STATUS_LINE(200, "OK"),
+            STATUS_LINE(206, "Partial Content"),
+            STATUS_LINE(304, "Not Modified"),
+            STATUS_LINE(400, "Bad Request"),
+            STATUS_LINE(403, "Forbidden"),
+            STATUS_LINE(404, "Not Found"),
+            STATUS_LINE(416, "Range Not Satisfiable"),
+            STATUS_LINE(500, "Internal Error"),
+        };
+#undef STATUS_LINE
+        for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); ++i) {
+            if (lines[i].status == status) {
+                return lines[i].line;
+            }
+        }
+        return std::string_view();
+    }
+
+    /**
+     * @brief 把 value 的十进制表示写入 buf
+     *
+     * @param buf 至少 MAX_UINT_DIGITS 字节
+     * @return 写入的字节数
+     */
+    static int format_uint(char* buf, uint64_t value) {
+        static const char digits[] =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+
+        // 从后往前每次写两位，最后整体前移
+        char tmp[MAX_UINT_DIGITS];
+        char* p = tmp + MAX_UINT_DIGITS;
+        while (value >= 100) {
+            unsigned i = (unsigned)(value % 100) * 2;
+            value /= 100;
+            *--p = digits[i + 1];
+            *--p = digits[i];
+        }
+        if (value >= 10) {
+            unsigned i = (unsigned)value * 2;
+            *--p = digits[i + 1];
+            *--p = digits[i];
+        } else {
+            *--p = (char)('0' + value);
+        }
+        int len = tmp + MAX_UINT_DIGITS - p;
+        memcpy(buf, p, len);
+        return len;
+    }
+
+    /** @brief 当前时间的 Date 响应头（含 \r\n），本线程内同一秒只格式化一次 */
+    static std::string_view date() {
+        static thread_local time_t last = -1;
+        static thread_local char buf[48];
+        static thread_local int len = 0;
+
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME_COARSE, &now);
+        if (now.tv_sec != last) {
+            struct tm tm;
+            gmtime_r(&now.tv_sec, &tm);
+            len = strftime(buf, sizeof(buf), "Date:%a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+            last = now.tv_sec;
+        }
+        return std::string_view(buf, len);
+    }
+};
+
+#endif  // !HEADER_WRITER_H
@@ -4,22 +4,26 @@
 
 #include <fstream>
 
-// 定义 http 响应的一些状态信息
-const char* ok_200_title = "OK";
-const char* error_400_title = "Bad Request";
+// 错误页面的正文，状态行见 header_writer
 const char* error_400_form = "Your request has bad syntax or is inherently impossible to satisfy.\n";
-const char* error_403_title = "Forbidden";
 const char* error_403_form = "You do not have permission to get file form this server.\n";
-const char* error_404_title = "Not Found";
 const char* error_404_form = "The requested file was not found on this server.\n";
-const char* error_500_title = "Internal Error";
 const char* error_500_form = "There was an unusual problem serving the request file.\n";
 
 locker m_lock;
 map<string, string> users;
 
-int http_conn::m_user_count = 0;
-int http_conn::m_epollfd = -1;
+std::atomic<int> http_conn::m_user_count(0);
+buffer_pool http_conn::m_buf_pool(http_conn::WRITE_BUFFER_SIZE);
+buffer_pool http_conn::m_block_pool(http_conn::READ_BUFFER_SIZE);
+int http_conn::m_access_sample = 0;
+
+// 访问日志开启时记录读到请求的时间
+static inline uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
 
 /** @brief 对文件描述符设置非阻塞 */
 int setnonblocking(int fd) {
@@ -52,8 +56,8 @@ void addfd(int epollfd, int fd, bool one_shot, int TRIGMode) {
         event.events |= EPOLLONESHOT;
     }
 
+    // 连接在 accept4 时已经带上 SOCK_NONBLOCK，这里不再额外 fcntl
     epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &event);
-    setnonblocking(fd);
 }
 
 /**
@@ -83,33 +87,41 @@ void modfd(int epollfd, int fd, int ev, int TRIGMode) {
 /**
  * @brief 初始化连接对象（带多个参数的版本）
  *
+ * @param epollfd       连接所属 reactor 的内核事件表
+ * @param completion    连接所属 reactor 的完成通知队列
  * @param sockfd        客户端套接字描述符
  * @param addr          客户端地址结构体
  * @param root          网站根目录路径
  * @param TRIGMode      触发模式（0 表示 LT 模式，1 表示 ET 模式）
  * @param close_log     是否关闭日志功能（0 启用日志，1 关闭日志）
- * @param user          数据库用户名
- * @param passwd        数据库密码
- * @param sqlname       数据库名称
+ * @param zerocopy      是否用 sendfile 发送静态文件（0 mmap + writev，1 sendfile）
  */
-void http_conn::init(int sockfd, const sockaddr_in& addr, char* root, int TRIGMode, int close_log, string user,
-                     string passwd, string sqlname) {
+void http_conn::init(int epollfd, completion_queue* completion, int sockfd, const sockaddr_in& addr, char* root,
+                     int TRIGMode, int close_log, int zerocopy) {
+    // 写缓冲区只在连接存活期间占用，读缓冲块在读到数据时才取
+    if (!m_write_buf) {
+        m_write_buf = m_buf_pool.acquire();
+        m_user_count++;
+    }
+
+    m_epollfd = epollfd;
+    m_completion = completion;
     m_sockfd = sockfd;
     m_address = addr;
 
-    addfd(m_epollfd, sockfd, true, m_TRIGMode);
-    m_user_count++;
-
     // 当浏览器出现连接重置时，可能是 网站根目录出错 或 http响应格式出错 或者 访问的文件中内容完全为空
     doc_root = root;
     m_TRIGMode = TRIGMode;
     m_close_log = close_log;
-
-    strcpy(sql_user, user.c_str());
-    strcpy(sql_passwd, passwd.c_str());
-    strcpy(sql_name, sqlname.c_str());
+    m_zerocopy = zerocopy;
 
     init();
+
+    // 连接状态全部就绪后再注册事件；连接对象会被复用，不能按上一个连接的触发模式注册
+    // io_uring 后端不使用 epoll
+    if (m_epollfd != -1) {
+        addfd(m_epollfd, sockfd, true, m_TRIGMode);
+    }
 }
 
 /**
@@ -122,29 +134,312 @@ void http_conn::close_conn(bool real_close) {
         printf("close %d\n", m_sockfd);
         removefd(m_epollfd, m_sockfd);
         m_sockfd = -1;
-        m_user_count--;
+        release();
     }
 }
 
+/**
+ * @brief 连接关闭后归还读缓冲块、写缓冲区并减少连接计数
+ *
+ * 连接可能由定时器回调、工作线程或 io_uring 后端关闭，以写缓冲区是否已归还判断是否重复调用
+ */
+void http_conn::release() {
+    if (!m_write_buf) {
+        return;
+    }
+    m_deferred = NO_REQUEST;
+    unmap();
+    m_read_chain.clear();
+    m_read_buf = NULL;
+    m_buf_pool.release(m_write_buf);
+    m_write_buf = NULL;
+    m_user_count--;
+}
+
 /**
  * @brief 处理客户端请求，调用读写操作
  */
 void http_conn::process() {
-    HTTP_CODE read_ret = process_read();
+    int ret = handle_request();
     // 如果请求未完整读取，重新监听读事件并返回
-    if (read_ret == NO_REQUEST) {
+    if (0 == ret) {
         modfd(m_epollfd, m_sockfd, EPOLLIN, m_TRIGMode);
         return;
     }
 
-    bool write_ret = process_write(read_ret);
-    if (!write_ret) {
-        close_conn();
+    if (ret < 0) {
+        // 工作线程中不直接关闭描述符，交给所属 reactor 在 EPOLLHUP 时关闭并删除嵌入的定时器
+        shutdown(m_sockfd, SHUT_RDWR);
     }
     // 修改 epoll 监听事件为写事件，继续等待下一次写操作
     modfd(m_epollfd, m_sockfd, EPOLLOUT, m_TRIGMode);
 }
 
+/**
+ * @brief 解析读缓冲区中的请求并生成响应，不涉及 epoll，供不同的 I/O 后端复用
+ *
+ * @return 0 表示请求尚不完整需要继续读，1 表示响应已经就绪，-1 表示生成响应失败需要关闭连接
+ */
+int http_conn::handle_request() {
+    int responses = 0;
+
+    // 依次处理读缓冲链中所有完整的请求（流水线），响应追加到同一批 iovec 中，由一次 writev 发出
+    while (responses < MAX_PIPELINE && WRITE_BUFFER_SIZE - m_write_idx >= MAX_RESPONSE_HEAD &&
+           MAX_IOV - m_iv_count >= MAX_RESPONSE_IOV) {
+        // 上一批放不下的请求已经解析完，直接生成响应
+        HTTP_CODE read_ret = NO_REQUEST == m_deferred ? process_read() : m_deferred;
+        m_deferred = NO_REQUEST;
+        if (read_ret == NO_REQUEST) {
+            break;
+        }
+
+        int resp_start = m_write_idx;
+        // process_write 可能把 m_file 换成压缩变体，保留原文件以便推迟时从头生成
+        file_ref file = m_file;
+        if (!process_write(read_ret)) {
+            if (responses == 0) {
+                return -1;
+            }
+            // 写缓冲区放不下本响应：撤销已写入的部分，先发完已经生成的响应，本请求不丢弃，留到下一批
+            m_write_idx = resp_start;
+            m_file = std::move(file);
+            m_deferred = read_ret;
+            break;
+        }
+        ++responses;
+        // 每个响应只记录一次响应头（错误页面含正文），正文不在写缓冲区中
+        LOG_DEBUG("response:%.*s", m_write_idx - resp_start, m_write_buf + resp_start);
+        log_access(m_request.method, m_request.path, m_request.version, m_status, m_body_bytes);
+        m_keep_alive = m_linger;
+        next_request();
+
+        // 非长连接的请求之后不再处理；多段范围响应的部分头占用 m_multipart，一批只能有一个
+        if (!m_keep_alive || !m_multipart.empty()) {
+            break;
+        }
+    }
+    return responses > 0 ? 1 : 0;
+}
+
+/**
+ * @brief 事件循环读到数据后先尝试由响应缓存直接应答，命中时不再经过线程池和请求解析
+ *
+ * 只处理读缓冲链中恰好是一个完整 GET 请求、没有请求体也没有后续流水线请求的情况，
+ * 这里只读不写读缓冲区，不满足条件时解析状态保持不变，交给常规路径处理
+ *
+ * @return 响应已放入待发送的 iovec 时返回 true，调用方接着调用 write()
+ */
+bool http_conn::serve_cached() {
+    if (m_read_chain.count() != 1 || m_check_state != CHECK_STATE_REQUESTLINE || bytes_to_send != 0) {
+        return false;
+    }
+    buffer_chain::block& b = m_read_chain.at(0);
+    const char* begin = b.data + b.begin;
+    const char* end = b.data + b.end;
+
+    // 请求行：GET <url> HTTP/1.1
+    if (end - begin < 4 || memcmp(begin, "GET ", 4) != 0) {
+        return false;
+    }
+    const char* eol = http_parser::find_eol(begin, end);
+    const char* url = begin + 4;
+    const char* url_end = http_parser::find_any(url, eol, " ", 1);
+    if (eol == end || url_end == eol || *url != '/' ||
+        std::string_view(url_end + 1, eol - url_end - 1) != std::string_view("HTTP/1.1")) {
+        return false;
+    }
+
+    // 请求头：只关心 Connection、Accept-Encoding 与 If-None-Match，带请求体、范围或日期条件的请求交给常规路径
+    bool keep_alive = false;
+    std::string_view accept_encoding;
+    std::string_view if_none_match;
+    bool has_if_none_match = false;
+    const char* line = eol;
+    while (true) {
+        if (end - line < 2 || line[0] != '\r' || line[1] != '\n') {
+            return false;
+        }
+        line += 2;
+        if (end - line >= 2 && line[0] == '\r' && line[1] == '\n') {
+            break;
+        }
+        eol = http_parser::find_eol(line, end);
+        if (eol == end) {
+            return false;
+        }
+        const char* colon = http_parser::find_any(line, eol, ":", 1);
+        if (colon != eol) {
+            const char* value = http_parser::skip_ws(colon + 1, eol);
+            switch (header_table::lookup(std::string_view(line, colon - line))) {
+                case HDR_CONNECTION:
+                    if (http_parser::iequals(std::string_view(value, eol - value), "keep-alive")) {
+                        keep_alive = true;
+                    }
+                    break;
+                case HDR_ACCEPT_ENCODING:
+                    accept_encoding = std::string_view(value, eol - value);
+                    break;
+                case HDR_IF_NONE_MATCH:
+                    if_none_match = std::string_view(value, eol - value);
+                    has_if_none_match = true;
+                    break;
+                case HDR_CONTENT_LENGTH:
+                case HDR_TRANSFER_ENCODING:
+                case HDR_RANGE:
+                case HDR_IF_MODIFIED_SINCE:
+                    return false;
+                default:
+                    break;
+            }
+        }
+        line = eol;
+    }
+    // 空行之后还有数据（流水线中的下一个请求）时交给常规路径
+    if (line + 2 != end) {
+        return false;
+    }
+
+    std::string_view path(url, url_end - url);
+    m_response = response_cache::get_instance()->lookup(path);
+    if (!m_response) {
+        return false;
+    }
+
+    // 按 Accept-Encoding 选择原文件或 gzip 变体，If-None-Match 与所选表示的 ETag 比较，与常规路径一致
+    int gzip = m_response->gzip && http_parser::accepts_gzip(accept_encoding);
+    const file_ref& file = gzip ? m_response->gzip : m_response->file;
+    bool not_modified = has_if_none_match && http_parser::etag_match(if_none_match, file->etag);
+    // 请求行还在读缓冲链中，清空之前记录；上面只接受 HTTP/1.1 的请求行
+    log_access("GET", path, "HTTP/1.1", not_modified ? 304 : 200, not_modified ? 0 : file->st.st_size);
+
+    m_read_chain.clear();
+    m_read_block = 0;
+    reset_request();
+    const std::string& bytes =
+        not_modified ? m_response->not_modified[gzip][keep_alive] : m_response->full[gzip][keep_alive];
+    // 状态行与随时间变化的 Date 写入写缓冲区，其余部分直接指向缓存的响应
+    add_status_line(not_modified ? 304 : 200);
+    add_iovec(m_write_buf, m_write_idx);
+    add_iovec((char*)bytes.data(), bytes.size());
+    m_keep_alive = keep_alive;
+    return true;
+}
+
+/**
+ * @brief 向访问日志写一行 Common Log Format，末尾追加从读到请求到生成响应的耗时（微秒）
+ *
+ * 形如 127.0.0.1 - - [16/Oct/2026:20:47:32 +0800] "GET /index.html HTTP/1.1" 200 724 153，
+ * 每个线程独立计数，每 m_access_sample 个响应记录一个
+ */
+void http_conn::log_access(std::string_view method, std::string_view path, std::string_view version, int status,
+                           off_t bytes) {
+    static thread_local unsigned counter = 0;
+    static thread_local time_t last = -1;
+    static thread_local char stamp[40];
+    if (m_access_sample <= 0 || ++counter % m_access_sample != 0) {
+        return;
+    }
+
+    uint64_t now = monotonic_ns();
+    time_t t = time(NULL);
+    if (t != last) {
+        struct tm tm;
+        localtime_r(&t, &tm);
+        strftime(stamp, sizeof(stamp), "%d/%b/%Y:%H:%M:%S %z", &tm);
+        last = t;
+    }
+    char host[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &m_address.sin_addr, host, sizeof(host));
+    // 无法解析的请求没有方法和路径，请求行不完整时也没有版本
+    if (path.empty()) {
+        method = path = "-";
+    }
+    if (version.empty()) {
+        version = "-";
+    }
+    char size[24] = "-";
+    if (bytes > 0) {
+        size[header_writer::format_uint(size, bytes)] = '\0';
+    }
+    Log::get_access()->write_plain("%s - - [%s] \"%.*s %.*s %.*s\" %d %s %llu", host, stamp, (int)method.size(),
+                                   method.data(), (int)path.size(), path.data(), (int)version.size(), version.data(),
+                                   status, size,
+                                   (unsigned long long)(m_read_ns && now > m_read_ns ? (now - m_read_ns) / 1000 : 0));
+}
+
+/**
+ * @brief 把由其它 I/O 后端读到的数据追加到读缓冲链
+ *
+ * @return 读缓冲链已满时返回 false，与 read_once 读满时的处理一致
+ */
+bool http_conn::append_read(const char* data, int len) {
+    if (len <= 0 || !m_write_buf) {
+        return false;
+    }
+    if (m_access_sample > 0) {
+        m_read_ns = monotonic_ns();
+    }
+    return m_read_chain.append(data, len);
+}
+
+/**
+ * @brief 记录已发送的字节数，并调整 iovec 指向剩余未发送的数据
+ *
+ * @param bytes 本次实际发送的字节数
+ * @return 响应全部发送完毕返回 true
+ */
+bool http_conn::advance_send(ssize_t bytes) {
+    bytes_have_send += bytes;
+    bytes_to_send -= bytes;
+    // 跳过已经全部发送的段，部分发送的那段调整起始位置（文件段调整文件偏移）
+    while (bytes > 0 && m_iv_idx < m_iv_count) {
+        struct iovec& iv = m_iv[m_iv_idx];
+        if ((size_t)bytes >= iv.iov_len) {
+            bytes -= iv.iov_len;
+            iv.iov_len = 0;
+            ++m_iv_idx;
+        } else if (m_iv_fd[m_iv_idx] >= 0) {
+            m_iv_off[m_iv_idx] += bytes;
+            iv.iov_len -= bytes;
+            bytes = 0;
+        } else {
+            iv.iov_base = (char*)iv.iov_base + bytes;
+            iv.iov_len -= bytes;
+            bytes = 0;
+        }
+    }
+
+    return bytes_to_send <= 0;
+}
+
+/**
+ * @brief 一批响应发送完毕后的收尾：释放文件映射，长连接重置响应状态准备处理下一批请求
+ *
+ * 读缓冲链中未处理的流水线请求保留下来，调用方通过 in_request() 判断是否需要立即继续处理
+ *
+ * @return 需要保持连接返回 true，否则返回 false
+ */
+bool http_conn::finish_response() {
+    unmap();
+    set_cork(false);
+    if (m_keep_alive) {
+        reset_response();
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief reactor 模式下工作线程处理完读写后调用，把结果回报给所属 reactor
+ *
+ * timer_flag 在 post 之前写入，完成队列的互斥锁保证 reactor 取到结果时能看到它
+ */
+void http_conn::complete() {
+    if (m_sockfd != -1) {
+        m_completion->post(m_sockfd);
+    }
+}
+
 /**
  * @brief 从客户端 socket 一次性读取数据到读缓冲区
  *
@@ -154,24 +449,42 @@ void http_conn::process() {
  * @return 成功读取返回 true，读取失败或连接关闭返回 false
  */
 bool http_conn::read_once() {
-    if (m_read_idx >= READ_BUFFER_SIZE) {
+    // 连接已被关闭、缓冲区已归还时，残留在线程池中的任务直接失败
+    if (!m_write_buf) {
         return false;
     }
     int bytes_read = 0;
+    int space = 0;
+    char* buf = NULL;
 
     // LT 读取数据
     if (0 == m_TRIGMode) {
-        bytes_read = recv(m_sockfd, m_read_buf + m_read_idx, READ_BUFFER_SIZE - m_read_idx, 0);
-        m_read_idx += bytes_read;
+        // 读缓冲链已满
+        if (!(buf = m_read_chain.write_space(space))) {
+            return false;
+        }
+        bytes_read = recv(m_sockfd, buf, space, 0);
 
         if (bytes_read <= 0) {
             return false;
         }
+        m_read_chain.commit(bytes_read);
+        if (m_access_sample > 0) {
+            m_read_ns = monotonic_ns();
+        }
 
         return true;
     } else {  // ET 读取数据
+        bool got = false;
         while (true) {
-            bytes_read = recv(m_sockfd, m_read_buf + m_read_idx, READ_BUFFER_SIZE - m_read_idx, 0);
+            // 读缓冲链已满时先交给解析，超长的行由 parse_line 作为错误请求应答；本次一点都没读到才失败
+            if (!(buf = m_read_chain.write_space(space))) {
+                if (!got) {
+                    return false;
+                }
+                break;
+            }
+            bytes_read = recv(m_sockfd, buf, space, 0);
             if (bytes_read == -1) {
                 if (errno == EAGAIN || errno == EWOULDBLOCK) {
                     break;
@@ -180,7 +493,11 @@ bool http_conn::read_once() {
             } else if (bytes_read == 0) {
                 return false;
             }
-            m_read_idx += bytes_read;
+            m_read_chain.commit(bytes_read);
+            got = true;
+        }
+        if (m_access_sample > 0) {
+            m_read_ns = monotonic_ns();
         }
         return true;
     }
@@ -189,53 +506,63 @@ bool http_conn::read_once() {
 /**
  * @brief 响应客户请求，将缓冲区中的数据写入 socket
  *
- * @return 成功写入返回 true，写入失败或连接关闭返回 false
+ * 结果在注册事件之前确定：一旦重新注册了事件，连接可能立即被其它线程处理，本线程与调用方都不能再操作它。
+ *
+ * @return WRITE_CLOSE 写入失败或不再保持连接；WRITE_WAIT 已注册可写（TCP 写缓冲区满）或可读事件；
+ *         WRITE_CONTINUE 本批响应已全部发出且读缓冲链中还有流水线请求，没有注册事件，由调用方直接处理
  */
-bool http_conn::write() {
-    int temp = 0;
+http_conn::WRITE_RESULT http_conn::write() {
+    ssize_t temp = 0;
 
     if (bytes_to_send == 0) {
-        // 将 epoll 的监听事件从 可写 改回 可读
+        // 先重置响应状态再重新注册读事件，避免下一个请求与重置并发
+        reset_response();
+        if (in_request()) {
+            return WRITE_CONTINUE;
+        }
         modfd(m_epollfd, m_sockfd, EPOLLIN, m_TRIGMode);
-        // 重置连接状态，准备接收下一个请求
-        init();
-        return true;
+        return WRITE_WAIT;
+    }
+
+    // 本批响应含文件段时先塞住 socket，响应头与文件内容合并成满长度的报文段，全部发完再拔出
+    if (m_zerocopy && m_file_count > 0) {
+        set_cork(true);
     }
 
     while (true) {
-        temp = writev(m_sockfd, m_iv, m_iv_count);
+        if (m_iv_fd[m_iv_idx] >= 0) {
+            // 文件段：sendfile 从页缓存直接发送，off_t 偏移支持超过 2GB 的文件
+            off_t offset = m_iv_off[m_iv_idx];
+            temp = sendfile(m_sockfd, m_iv_fd[m_iv_idx], &offset, m_iv[m_iv_idx].iov_len);
+        } else {
+            // 内存段：下一个文件段之前的所有内存段合并为一次 writev
+            int count = 0;
+            while (m_iv_idx + count < m_iv_count && m_iv_fd[m_iv_idx + count] < 0) {
+                ++count;
+            }
+            temp = writev(m_sockfd, get_iovec(), count);
+        }
         if (temp < 0) {
-            // 如果 TCP 写缓冲区满了
+            // 如果 TCP 写缓冲区满了，下次可写时从已记录的位置继续
             if (errno == EAGAIN) {
                 modfd(m_epollfd, m_sockfd, EPOLLOUT, m_TRIGMode);
-                return true;
+                return WRITE_WAIT;
             }
-            unmap();  // 释放内存映射
-            return false;
+            unmap();  // 释放本批响应引用的文件
+            return WRITE_CLOSE;
         }
 
-        bytes_have_send += temp;
-        bytes_to_send -= temp;
-        // 第一个 iovec 指向的缓冲区（通常是 HTTP 响应头）已经全部发送完毕
-        if (bytes_have_send >= m_iv[0].iov_len) {
-            m_iv[0].iov_len = 0;
-            m_iv[1].iov_base = m_file_address + (bytes_have_send - m_write_idx);
-            m_iv[1].iov_len = bytes_to_send;
-        } else {
-            m_iv[0].iov_base = m_write_buf + bytes_have_send;
-            m_iv[0].iov_len = m_iv[0].iov_len - bytes_have_send;
-        }
-
-        if (bytes_to_send <= 0) {
-            unmap();
-            modfd(m_epollfd, m_sockfd, EPOLLIN, m_TRIGMode);
-
-            if (m_linger) {
-                init();
-                return true;
-            } else {
-                return false;
+        if (advance_send(temp)) {
+            // 先重置连接状态再重新注册读事件，避免下一个请求与重置并发
+            if (!finish_response()) {
+                return WRITE_CLOSE;
             }
+            // 读缓冲链中还有流水线请求时由调用方直接处理，处理完再注册事件
+            if (in_request()) {
+                return WRITE_CONTINUE;
+            }
+            modfd(m_epollfd, m_sockfd, EPOLLIN, m_TRIGMode);
+            return WRITE_WAIT;
         }
     }
 }
@@ -280,8 +607,28 @@ void http_conn::initmysql_result(connection_pool* connPool) {
  */
 void http_conn::init() {
     mysql = NULL;
-    bytes_to_send = 0;
-    bytes_have_send = 0;
+    m_state = 0;
+    timer_flag = 0;
+    m_keep_alive = false;
+    m_deferred = NO_REQUEST;
+    m_read_ns = 0;
+    m_status = 0;
+    m_body_bytes = 0;
+    m_file.reset();
+    m_file_count = 0;
+    m_response.reset();
+    m_corked = false;
+
+    m_read_chain.clear();
+    m_read_block = 0;
+    reset_request();
+    reset_response();
+}
+
+/**
+ * @brief 重置请求解析状态，从读缓冲链当前位置开始解析下一个请求
+ */
+void http_conn::reset_request() {
     m_check_state = CHECK_STATE_REQUESTLINE;
     m_linger = false;
     m_method = GET;
@@ -289,20 +636,43 @@ void http_conn::init() {
     m_version = 0;
     m_content_length = 0;
     m_host = 0;
-    m_start_line = 0;
-    m_checked_idx = 0;
-    m_read_idx = 0;
-    m_write_idx = 0;
+    m_string = NULL;
     cgi = 0;
-    m_state = 0;
-    timer_flag = 0;
-    improv = 0;
-
-    memset(m_read_buf, '\0', READ_BUFFER_SIZE);
-    memset(m_write_buf, '\0', WRITE_BUFFER_SIZE);
+    m_request.clear();
+    m_line_end = 0;
+    m_read_idx = 0;
+    m_read_buf = NULL;
+    m_start_line = m_checked_idx = m_read_chain.empty() ? 0 : m_read_chain.at(m_read_block).begin;
+    if (!m_body.empty()) {
+        std::string().swap(m_body);
+    }
     memset(m_real_file, '\0', FILENAME_LEN);
 }
 
+/**
+ * @brief 一个请求的响应已经生成：丢弃它在读缓冲链中占用的数据，准备解析紧随其后的流水线请求
+ *
+ * 读缓冲块在请求之间归还给池，全部数据都已处理时空闲的长连接不占用读缓冲
+ */
+void http_conn::next_request() {
+    if (!m_read_chain.empty()) {
+        m_read_chain.consume(m_read_block, m_checked_idx);
+    }
+    m_read_block = 0;
+    reset_request();
+}
+
+/**
+ * @brief 重置写缓冲区与 iovec，准备生成下一批响应
+ */
+void http_conn::reset_response() {
+    bytes_to_send = 0;
+    bytes_have_send = 0;
+    m_write_idx = 0;
+    m_iv_count = 0;
+    m_iv_idx = 0;
+}
+
 /**
  * @brief 处理客户端发送的 HTTP 请求数据，解析请求行、请求头和请求体
  *
@@ -313,15 +683,21 @@ http_conn::HTTP_CODE http_conn::process_read() {
     HTTP_CODE ret = NO_REQUEST;
     char* text = 0;
 
+    // 读缓冲链在两次调用之间可能追加了新块
+    if (!sync_read_block()) {
+        return NO_REQUEST;
+    }
+
     while ((m_check_state == CHECK_STATE_CONTENT && line_status == LINE_OK) ||
            ((line_status = parse_line()) == LINE_OK)) {
         text = get_line();
         m_start_line = m_checked_idx;
-        LOG_INFO("%s", text);
+        LOG_DEBUG("%s", text);
         switch (m_check_state) {
             case CHECK_STATE_REQUESTLINE: {
                 ret = parse_request_line(text);
                 if (ret == BAD_REQUEST) {
+                    m_linger = false;
                     return BAD_REQUEST;
                 }
                 break;
@@ -329,6 +705,8 @@ http_conn::HTTP_CODE http_conn::process_read() {
             case CHECK_STATE_HEADER: {
                 ret = parse_headers(text);
                 if (ret == BAD_REQUEST) {
+                    // 请求格式错误时无法确定下一个请求从哪里开始，发完错误页面就关闭连接
+                    m_linger = false;
                     return BAD_REQUEST;
                 } else if (ret == GET_REQUEST) {
                     return do_request();
@@ -340,13 +718,18 @@ http_conn::HTTP_CODE http_conn::process_read() {
                 if (ret == GET_REQUEST) {
                     return do_request();
                 }
-                line_status = LINE_OPEN;
-                break;
+                // 请求体还没收全，直接等待更多数据，不能让 parse_line 把请求体当作行扫描而移动解析位置
+                return NO_REQUEST;
             }
             default:
                 return INTERNAL_ERROR;
         }
     }
+    if (line_status == LINE_BAD) {
+        // 行尾格式错误或请求行、请求头超长，无法确定下一个请求从哪里开始，发完错误页面就关闭连接
+        m_linger = false;
+        return BAD_REQUEST;
+    }
     return NO_REQUEST;
 }
 
@@ -357,46 +740,82 @@ http_conn::HTTP_CODE http_conn::process_read() {
  * @return 成功构造响应并准备发送返回 true，否则返回 false
  */
 bool http_conn::process_write(HTTP_CODE ret) {
+    // 流水线中前面的响应仍在写缓冲区中，本响应从当前位置开始追加
+    int resp_start = m_write_idx;
     switch (ret) {
         case INTERNAL_ERROR: {
-            add_status_line(500, error_500_title);
-            add_headers(strlen(error_500_form));
-            if (!add_content(error_500_form)) {
+            if (!(add_status_line(500) && add_headers(strlen(error_500_form)) && add_content(error_500_form))) {
                 return false;
             }
             break;
         }
         case BAD_REQUEST: {
-            add_status_line(404, error_404_title);
-            add_headers(strlen(error_404_form));
-            if (!add_content(error_404_form)) {
+            if (!(add_status_line(404) && add_headers(strlen(error_404_form)) && add_content(error_404_form))) {
                 return false;
             }
             break;
         }
         case FORBIDDEN_REQUEST: {
-            add_status_line(403, error_403_title);
-            add_headers(strlen(error_403_form));
-            if (!add_content(error_403_form)) {
+            if (!(add_status_line(403) && add_headers(strlen(error_403_form)) && add_content(error_403_form))) {
                 return false;
             }
             break;
         }
         case FILE_REQUEST: {
-            add_status_line(200, ok_200_title);
-            if (m_file_stat.st_size != 0) {
-                add_headers(m_file_stat.st_size);
-                m_iv[0].iov_base = m_write_buf;
-                m_iv[0].iov_len = m_write_idx;
-                m_iv[1].iov_base = m_file_address;
-                m_iv[1].iov_len = m_file_stat.st_size;
-                m_iv_count = 2;
-                bytes_to_send = m_write_idx + m_file_stat.st_size;
+            off_t size = m_file->st.st_size;
+            if (size != 0) {
+                const std::string& cache_control = cache_policy::get_instance()->lookup(m_request.path);
+                // 小文件的 GET 响应放入响应缓存，之后同一 URL 由事件循环直接应答
+                if (GET == m_method && !cgi && size <= response_cache::MAX_BODY) {
+                    response_cache::get_instance()->insert(m_request.path, m_file, cache_control);
+                }
+                // 客户端接受 gzip 时改发压缩变体，之后的校验器与响应头都取自变体；范围请求仍针对原文件
+                if (m_file->vary && !m_request.has(HDR_RANGE) &&
+                    http_parser::accepts_gzip(m_request.header(HDR_ACCEPT_ENCODING))) {
+                    file_ref gzip = gzip_cache::get_instance()->acquire(m_file);
+                    if (gzip) {
+                        m_file = std::move(gzip);
+                        size = m_file->st.st_size;
+                    }
+                }
+                // 条件请求先于 Range 判断，客户端缓存仍然有效时只回复响应头
+                if (not_modified()) {
+                    if (!(add_status_line(304) && add_bytes(m_file->validators) && add_bytes(cache_control) &&
+                          add_linger() && add_blank_line())) {
+                        return false;
+                    }
+                    m_file.reset();
+                    break;
+                }
+
+                byte_range ranges[MAX_RANGES];
+                int count = parse_ranges(ranges);
+                if (count > 0) {
+                    return add_partial(ranges, count, resp_start, cache_control);
+                }
+                if (0 == count) {
+                    // 所有范围都超出文件末尾
+                    if (!(add_status_line(416) && add_content_length(0) && add_bytes("Content-Range:bytes */") &&
+                          add_uint(size) && add_bytes("\r\n") && add_linger() && add_blank_line())) {
+                        return false;
+                    }
+                    break;
+                }
+
+                // Content-Length、Content-Type、Content-Encoding 与校验器由文件缓存预先生成
+                if (!(add_status_line(200) && add_bytes(m_file->header) && add_bytes(cache_control) && add_linger() &&
+                      add_blank_line())) {
+                    return false;
+                }
+                m_body_bytes = size;
+                add_iovec(m_write_buf + resp_start, m_write_idx - resp_start);
+                add_body(0, size);
+                // 文件引用交给本批响应，全部发送完后统一释放
+                m_files[m_file_count++] = std::move(m_file);
                 return true;
             } else {
                 const char* ok_string = "<html><body></body></html>";
-                add_headers(strlen(ok_string));
-                if (!add_content(ok_string)) {
+                if (!(add_status_line(200) && add_headers(strlen(ok_string)) && add_content(ok_string))) {
                     return false;
                 }
             }
@@ -404,10 +823,152 @@ bool http_conn::process_write(HTTP_CODE ret) {
         default:
             return false;
     }
-    m_iv[0].iov_base = m_write_buf;
-    m_iv[0].iov_len = m_write_idx;
-    m_iv_count = 1;
-    bytes_to_send = m_write_idx;
+    add_iovec(m_write_buf + resp_start, m_write_idx - resp_start);
+    return true;
+}
+
+/**
+ * @brief 把一段待发送数据追加到本批响应的 iovec 中，与上一段在内存中相连时直接合并
+ */
+void http_conn::add_iovec(char* base, size_t len) {
+    if (m_iv_count > 0 && m_iv_fd[m_iv_count - 1] < 0 &&
+        (char*)m_iv[m_iv_count - 1].iov_base + m_iv[m_iv_count - 1].iov_len == base) {
+        m_iv[m_iv_count - 1].iov_len += len;
+    } else {
+        m_iv[m_iv_count].iov_base = base;
+        m_iv[m_iv_count].iov_len = len;
+        m_iv_fd[m_iv_count] = -1;
+        ++m_iv_count;
+    }
+    bytes_to_send += len;
+}
+
+/**
+ * @brief 把文件中的一段作为待发送数据追加到本批响应中，发送时用 sendfile 代替 writev
+ */
+void http_conn::add_file(int fd, off_t offset, off_t len) {
+    m_iv[m_iv_count].iov_base = NULL;
+    m_iv[m_iv_count].iov_len = len;
+    m_iv_fd[m_iv_count] = fd;
+    m_iv_off[m_iv_count] = offset;
+    ++m_iv_count;
+    bytes_to_send += len;
+}
+
+/**
+ * @brief 把当前文件 [offset, offset + len) 追加到本批响应中
+ */
+void http_conn::add_body(off_t offset, off_t len) {
+    if (m_zerocopy) {
+        add_file(m_file->fd, offset, len);
+    } else {
+        add_iovec(m_file->addr + offset, len);
+    }
+}
+
+/**
+ * @brief 判断 GET 请求的客户端缓存是否仍然有效
+ *
+ * If-None-Match 优先，与文件的 ETag 弱比较；没有它时 If-Modified-Since 不早于文件的修改时间即有效，
+ * 晚于服务器当前时间的 If-Modified-Since 无效（RFC 7232 3.3），忽略它并返回完整响应
+ */
+bool http_conn::not_modified() {
+    if (GET != m_method) {
+        return false;
+    }
+    if (m_request.has(HDR_IF_NONE_MATCH)) {
+        return http_parser::etag_match(m_request.header(HDR_IF_NONE_MATCH), m_file->etag);
+    }
+    if (m_request.has(HDR_IF_MODIFIED_SINCE)) {
+        time_t since = http_parser::parse_http_date(m_request.header(HDR_IF_MODIFIED_SINCE));
+        return since >= 0 && since <= time(NULL) && m_file->st.st_mtime <= since;
+    }
+    return false;
+}
+
+/**
+ * @brief 解析当前 GET 请求的 Range
+ *
+ * 带 If-Range 时只有文件未变才按范围响应，否则返回完整的新内容。
+ * 实体标签形式与文件的 ETag 强比较（弱标签总不匹配），日期形式须与文件的 Last-Modified 完全相同
+ */
+int http_conn::parse_ranges(byte_range* ranges) {
+    std::string_view range = m_request.header(HDR_RANGE);
+    if (GET != m_method || range.empty()) {
+        return -1;
+    }
+    if (m_request.has(HDR_IF_RANGE)) {
+        std::string_view if_range = m_request.header(HDR_IF_RANGE);
+        bool match = !if_range.empty() && if_range[0] == '"'
+                         ? if_range == m_file->etag
+                         : http_parser::parse_http_date(if_range) == m_file->st.st_mtime;
+        if (!match) {
+            return -1;
+        }
+    }
+    return http_parser::parse_range(range, m_file->st.st_size, ranges, MAX_RANGES);
+}
+
+/**
+ * @brief 生成 206 响应，文件内容与普通响应一样由映射或 sendfile 直接发送
+ *
+ * 多个范围时正文为 multipart/byteranges：每段前是分隔行和该段的 Content-Type、Content-Range，最后是结束分隔行。
+ * 这些部分头先全部写入 m_multipart 并算出总长度，之后不再修改，iovec 直接指向其中各段
+ */
+bool http_conn::add_partial(const byte_range* ranges, int count, int resp_start, const std::string& cache_control) {
+    off_t size = m_file->st.st_size;
+    if (!(add_status_line(206) && add_bytes(m_file->validators) && add_bytes(cache_control))) {
+        return false;
+    }
+
+    if (1 == count) {
+        if (!(add_content_length(ranges[0].last - ranges[0].first + 1) && add_bytes("Content-Type:") &&
+              add_bytes(m_file->mime) && add_bytes("\r\nContent-Range:bytes ") && add_uint(ranges[0].first) &&
+              add_bytes("-") && add_uint(ranges[0].last) && add_bytes("/") && add_uint(size) && add_bytes("\r\n") &&
+              add_linger() && add_blank_line())) {
+            return false;
+        }
+        add_iovec(m_write_buf + resp_start, m_write_idx - resp_start);
+        add_body(ranges[0].first, ranges[0].last - ranges[0].first + 1);
+    } else {
+        // 分隔符不能出现在内容中，用文件的 inode、修改时间和序号生成
+        static std::atomic<unsigned> seq(0);
+        char boundary[24];
+        snprintf(boundary, sizeof(boundary), "%016llx",
+                 (unsigned long long)(((uint64_t)m_file->st.st_ino << 32) ^ (uint64_t)m_file->st.st_mtime ^
+                                      ((uint64_t)seq.fetch_add(1, std::memory_order_relaxed) * 0x9e3779b97f4a7c15ull)));
+
+        size_t offsets[MAX_RANGES + 1];
+        off_t total = 0;
+        char part[256];
+        m_multipart.clear();
+        for (int i = 0; i < count; ++i) {
+            offsets[i] = m_multipart.size();
+            int n = snprintf(part, sizeof(part),
+                             "\r\n--%s\r\nContent-Type:%s\r\nContent-Range:bytes %lld-%lld/%lld\r\n\r\n", boundary,
+                             m_file->mime, (long long)ranges[i].first, (long long)ranges[i].last, (long long)size);
+            m_multipart.append(part, n);
+            total += ranges[i].last - ranges[i].first + 1;
+        }
+        offsets[count] = m_multipart.size();
+        m_multipart.append("\r\n--").append(boundary).append("--\r\n");
+        total += m_multipart.size();
+
+        if (!(add_content_length(total) && add_bytes("Content-Type:multipart/byteranges; boundary=") &&
+              add_bytes(boundary) && add_bytes("\r\n") && add_linger() && add_blank_line())) {
+            m_multipart.clear();
+            return false;
+        }
+        add_iovec(m_write_buf + resp_start, m_write_idx - resp_start);
+        for (int i = 0; i < count; ++i) {
+            add_iovec(&m_multipart[offsets[i]], offsets[i + 1] - offsets[i]);
+            add_body(ranges[i].first, ranges[i].last - ranges[i].first + 1);
+        }
+        add_iovec(&m_multipart[offsets[count]], m_multipart.size() - offsets[count]);
+    }
+
+    // 文件引用交给本批响应，全部发送完后统一释放
+    m_files[m_file_count++] = std::move(m_file);
     return true;
 }
 
@@ -418,58 +979,50 @@ bool http_conn::process_write(HTTP_CODE ret) {
  * @return HTTP_CODE 返回解析状态码，指示是否成功解析请求行
  */
 http_conn::HTTP_CODE http_conn::parse_request_line(char* text) {
-    // strpbrk : 在一个字符串中查找第一个 匹配另一个字符串中任意字符的 字符位置
-    m_url = strpbrk(text, " \t");
-    if (!m_url) {
+    // 行尾位置由 parse_line 记录，之后的查找都限定在 [text, end) 内，用向量化扫描代替 strpbrk
+    char* end = m_read_buf + m_line_end;
+
+    char* sep = (char*)http_parser::find_any(text, end, " \t", 2);
+    if (sep == end) {
         return BAD_REQUEST;
     }
-    *m_url++ = '\0';
-    // strspn : 计算字符串开头连续包含指定字符集合的字符数量 (在这里为了跳过前导空格)
-    m_url += strspn(m_url, " \t");
+    m_request.method = std::string_view(text, sep - text);
+    *sep = '\0';
+    m_url = (char*)http_parser::skip_ws(sep + 1, end);
 
-    char* method = text;
-    // strcasecmp : 大小写不敏感 的字符串比较函数
-    if (strcasecmp(method, "GET") == 0) {
+    if (http_parser::iequals(m_request.method, "GET")) {
         m_method = GET;
-    } else if (strcasecmp(method, "POST") == 0) {
+    } else if (http_parser::iequals(m_request.method, "POST")) {
         m_method = POST;
         cgi = 1;
     } else {
         return BAD_REQUEST;
     }
 
-    m_version = strpbrk(m_url, " \t");
-    if (!m_version) {
+    char* url_end = (char*)http_parser::find_any(m_url, end, " \t", 2);
+    if (url_end == end) {
         return BAD_REQUEST;
     }
-    *m_version++ = '\0';
-    m_version += strspn(m_version, " \t");
+    *url_end = '\0';
+    m_version = (char*)http_parser::skip_ws(url_end + 1, end);
+    m_request.version = std::string_view(m_version, end - m_version);
 
-    if (strcasecmp(m_version, "HTTP/1.1") != 0) {
+    if (!http_parser::iequals(m_request.version, "HTTP/1.1")) {
         return BAD_REQUEST;
     }
 
-    // strncasecmp : 在指定长度内，忽略大小写地比较两个字符串
-    if (strncasecmp(m_url, "http://", 7) == 0) {
-        m_url += 7;
-        // strchr : 在字符串中查找某个字符第一次出现的位置
-        m_url = strchr(m_url, '/');
-    }
-
-    if (strncasecmp(m_url, "https://", 8) == 0) {
-        m_url += 8;
-        m_url = strchr(m_url, '/');
+    // 绝对形式的 URL 只保留路径部分
+    std::string_view url(m_url, url_end - m_url);
+    if (url.size() >= 7 && strncasecmp(m_url, "http://", 7) == 0) {
+        m_url = (char*)memchr(m_url + 7, '/', url.size() - 7);
+    } else if (url.size() >= 8 && strncasecmp(m_url, "https://", 8) == 0) {
+        m_url = (char*)memchr(m_url + 8, '/', url.size() - 8);
     }
 
     if (!m_url || m_url[0] != '/') {
         return BAD_REQUEST;
     }
-
-    // 当 url 为 / 时，显示判断界面
-    if (strlen(m_url) == 1) {
-        // strcat : 将一个字符串拼接到另一个字符串的末尾
-        strcat(m_url, "judge.html");
-    }
+    m_request.path = std::string_view(m_url, url_end - m_url);
 
     m_check_state = CHECK_STATE_HEADER;
     return NO_REQUEST;
@@ -488,22 +1041,40 @@ http_conn::HTTP_CODE http_conn::parse_headers(char* text) {
             return NO_REQUEST;
         }
         return GET_REQUEST;
-    } else if (strncasecmp(text, "Connection:", 11) == 0) {
-        text += 11;
-        text += strspn(text, " \t");
-        if (strcasecmp(text, "keep-alive") == 0) {
-            m_linger = true;
-        }
-    } else if (strncasecmp(text, "Content-length:", 15) == 0) {
-        text += 15;
-        text += strspn(text, " \t");
-        m_content_length = atol(text);
-    } else if (strncasecmp(text, "Host:", 5) == 0) {
-        text += 5;
-        text += strspn(text, " \t");
-        m_host = text;
-    } else {
-        LOG_INFO("Unknown header: %s", text);
+    }
+
+    char* end = m_read_buf + m_line_end;
+    char* colon = (char*)http_parser::find_any(text, end, ":", 1);
+    // 没有冒号的行直接忽略
+    if (colon == end) {
+        return NO_REQUEST;
+    }
+
+    // 所有请求头都记入请求视图，标准请求头经编译期完美哈希得到编号，之后按编号 O(1) 读取
+    std::string_view name(text, colon - text);
+    char* value = (char*)http_parser::skip_ws(colon + 1, end);
+    http_header_id id = header_table::lookup(name);
+    m_request.add(id, name, std::string_view(value, end - value));
+
+    switch (id) {
+        case HDR_CONNECTION:
+            if (http_parser::iequals(std::string_view(value, end - value), "keep-alive")) {
+                m_linger = true;
+            }
+            break;
+        case HDR_CONTENT_LENGTH:
+            // 请求体必须能放进读缓冲链，负数、非数字或超长的长度都按错误请求处理
+            m_content_length = http_parser::parse_content_length(std::string_view(value, end - value),
+                                                                 m_read_chain.max_size());
+            if (m_content_length < 0) {
+                return BAD_REQUEST;
+            }
+            break;
+        case HDR_HOST:
+            m_host = value;
+            break;
+        default:
+            break;
     }
     return NO_REQUEST;
 }
@@ -515,13 +1086,37 @@ http_conn::HTTP_CODE http_conn::parse_headers(char* text) {
  * @return HTTP_CODE 返回解析状态码，指示是否成功解析完整请求体
  */
 http_conn::HTTP_CODE http_conn::parse_content(char* text) {
-    if (m_read_idx >= (m_checked_idx + m_content_length)) {
+    if (m_read_chain.size_from(m_read_block, m_checked_idx) < m_content_length) {
+        return NO_REQUEST;
+    }
+
+    // POST 请求中最后为输入的用户名和密码
+    if (m_read_idx == (m_checked_idx + m_content_length)) {
+        // 请求体恰好到当前块的数据末尾，块末尾预留了写入 '\0' 的位置
         text[m_content_length] = '\0';
-        // POST 请求中最后为输入的用户名和密码
         m_string = text;
-        return GET_REQUEST;
+        m_checked_idx += m_content_length;
+    } else if (m_read_idx > (m_checked_idx + m_content_length)) {
+        // 请求体之后紧跟着流水线中的下一个请求，复制出来，不能在原处写 '\0'
+        m_body.assign(text, m_content_length);
+        m_string = &m_body[0];
+        m_checked_idx += m_content_length;
+    } else {
+        // 请求体跨块，拼接到一段连续内存中
+        m_body.assign(text, m_read_idx - m_checked_idx);
+        m_checked_idx = m_read_idx;
+        while ((long)m_body.size() < m_content_length) {
+            buffer_chain::block& b = m_read_chain.at(++m_read_block);
+            long n = b.end - b.begin;
+            if (n > m_content_length - (long)m_body.size()) {
+                n = m_content_length - m_body.size();
+            }
+            m_body.append(b.data + b.begin, n);
+            m_checked_idx = b.begin + n;
+        }
+        m_string = &m_body[0];
     }
-    return NO_REQUEST;
+    return GET_REQUEST;
 }
 
 /**
@@ -549,18 +1144,24 @@ http_conn::HTTP_CODE http_conn::do_request() {
         strncpy(m_real_file + len, m_url_real, FILENAME_LEN - len - 1);
         free(m_url_real);
 
-        // 将用户名和密码提取出来
+        // 将用户名和密码提取出来，请求体可以跨多个读缓冲块，超出数组长度的部分截断
         // user=123&passwd=123
         char name[100], password[100];
-        int i;
-        for (i = 5; m_string[i] != '&'; ++i) {
-            name[i - 5] = m_string[i];
+        const char* field = strchr(m_string, '=');
+        int j = 0;
+        for (field = field ? field + 1 : ""; *field != '&' && *field != '\0'; ++field) {
+            if (j < (int)sizeof(name) - 1) {
+                name[j++] = *field;
+            }
         }
-        name[i - 5] = '\0';
+        name[j] = '\0';
 
-        int j = 0;
-        for (i = i + 10; m_string[i] != '\0'; ++i, ++j) {
-            password[j] = m_string[i];
+        field = strchr(field, '=');
+        j = 0;
+        for (field = field ? field + 1 : ""; *field != '\0'; ++field) {
+            if (j < (int)sizeof(password) - 1) {
+                password[j++] = *field;
+            }
         }
         password[j] = '\0';
 
@@ -630,112 +1231,181 @@ http_conn::HTTP_CODE http_conn::do_request() {
         strncpy(m_real_file + len, m_url_real, strlen(m_url_real));
 
         free(m_url_real);
+    } else if (m_url[1] == '\0') {
+        // 当 url 为 / 时，显示判断界面
+        strncpy(m_real_file + len, "/judge.html", FILENAME_LEN - len - 1);
     } else {
         strncpy(m_real_file + len, m_url, FILENAME_LEN - len - 1);
     }
 
-    // stat : 尝试获取 m_real_file 路径对应文件的信息，并存入 m_file_stat 结构体
-    // 如果函数返回负值 (< 0)，意味着 这个文件或路径不存在
-    if (stat(m_real_file, &m_file_stat) < 0) {
-        return NO_RESOURCE;
-    }
-
-    // m_file_stat.st_mode : 包含了文件的类型和权限信息
-    // S_IROTH : 表示其他人可读的权限
-    if (!(m_file_stat.st_mode & S_IROTH)) {
-        return FORBIDDEN_REQUEST;
-    }
-
-    // S_ISDIR : 用于判断给定的路径是否为一个目录
-    if (S_ISDIR(m_file_stat.st_mode)) {
-        return BAD_REQUEST;
-    }
-
     // LOG_INFO("m_real_file: %s", m_real_file);
 
-    int fd = open(m_real_file, O_RDONLY);
-    // mmap : 将文件直接映射到进程的虚拟内存空间中
-    // PROT_READ : 这块内存区域是可读的
-    // MAP_PRIVATE : 创建一个私有的、写时复制 (Copy-on-Write) 的映射
-    m_file_address = (char*)mmap(0, m_file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    close(fd);
-    return FILE_REQUEST;
+    // 文件缓存命中时直接得到已打开的文件（零拷贝模式下为描述符，否则为映射），不再 stat / open / mmap
+    // 不存在、其他人不可读 (S_IROTH) 或是目录的路径与原先一样分别返回 404、403 和 400
+    switch (file_cache::get_instance()->acquire(m_real_file, m_file)) {
+        case file_cache::FILE_MISSING:
+            return NO_RESOURCE;
+        case file_cache::FILE_FORBIDDEN:
+            return FORBIDDEN_REQUEST;
+        case file_cache::FILE_DIRECTORY:
+            return BAD_REQUEST;
+        default:
+            return FILE_REQUEST;
+    }
 }
 
 /**
  * @brief 解析一行 HTTP 请求数据，判断该行是否完整（从状态机）
  *
- * @return LINE_STATUS 表示当前行的解析状态（LINE_OK / LINE_BAD / LINE_OPEN）
+ * @return LINE_STATUS 表示当前行的解析状态（LINE_OK / LINE_BAD / LINE_OPEN），
+ *         行尾格式错误或一行超过一个读缓冲块时为 LINE_BAD
  */
 http_conn::LINE_STATUS http_conn::parse_line() {
-    char temp;
-    for (; m_checked_idx < m_read_idx; ++m_checked_idx) {
-        temp = m_read_buf[m_checked_idx];
-        if (temp == '\r') {
-            // '\r' 是缓冲区的最后一个字符，可能 '\n' 还没收到
-            if ((m_checked_idx + 1) == m_read_idx) {
-                return LINE_OPEN;
-            }
-            // '\r' 的下一个字符是 '\n'，找到了完整的行
-            else if (m_read_buf[m_checked_idx + 1] == '\n') {
-                // 将 '\r' 和 '\n' 替换为字符串结束符 '\0'
-                m_read_buf[m_checked_idx++] = '\0';
-                m_read_buf[m_checked_idx++] = '\0';
-                return LINE_OK;
-            }
+    const char* pos;
+    while (true) {
+        if (!sync_read_block()) {
+            return LINE_OPEN;
+        }
+        // 向量化查找下一个 '\r' 或 '\n'，其间的普通字符不再逐个比较
+        const char* end = m_read_buf + m_read_idx;
+        pos = http_parser::find_eol(m_read_buf + m_checked_idx, end);
+        m_checked_idx = pos - m_read_buf;
+        // '\r' 是块中最后一个字符时，'\n' 可能在下一块
+        if (pos != end && !(*pos == '\r' && (m_checked_idx + 1) == m_read_idx)) {
+            break;
+        }
+        // 残行已占满整块：行不能跨块，再读多少数据也不可能完整，立即作为错误请求处理
+        if (m_read_idx - m_start_line >= m_read_chain.capacity()) {
             return LINE_BAD;
+        }
+        if (!next_read_block()) {
+            return LINE_OPEN;
+        }
+    }
 
-        } else if (temp == '\n') {
-            // 检查前一个字符是不是 '\r'
-            if (m_checked_idx > 1 && m_read_buf[m_checked_idx - 1] == '\r') {
-                // 将 '\r' 和 '\n' 替换为字符串结束符 '\0'
-                m_read_buf[m_checked_idx - 1] = '\0';
-                m_read_buf[m_checked_idx++] = '\0';
-                return LINE_OK;
-            }
-            return LINE_BAD;
+    if (*pos == '\r') {
+        // '\r' 是缓冲区的最后一个字符，可能 '\n' 还没收到
+        if ((m_checked_idx + 1) == m_read_idx) {
+            return LINE_OPEN;
+        }
+        // '\r' 的下一个字符是 '\n'，找到了完整的行
+        else if (m_read_buf[m_checked_idx + 1] == '\n') {
+            // 将 '\r' 和 '\n' 替换为字符串结束符 '\0'
+            m_line_end = m_checked_idx;
+            m_read_buf[m_checked_idx++] = '\0';
+            m_read_buf[m_checked_idx++] = '\0';
+            return LINE_OK;
         }
+        return LINE_BAD;
     }
 
-    return LINE_OPEN;
+    // 检查前一个字符是不是 '\r'
+    if (m_checked_idx > m_start_line && m_read_buf[m_checked_idx - 1] == '\r') {
+        // 将 '\r' 和 '\n' 替换为字符串结束符 '\0'
+        m_line_end = m_checked_idx - 1;
+        m_read_buf[m_checked_idx - 1] = '\0';
+        m_read_buf[m_checked_idx++] = '\0';
+        return LINE_OK;
+    }
+    return LINE_BAD;
 }
 
 /**
- * @brief 取消内存映射，释放由 mmap 映射的文件资源
+ * @brief 让 m_read_buf / m_read_idx 指向当前解析的块
+ *
+ * @return 读缓冲链为空时返回 false
  */
-void http_conn::unmap() {
-    if (m_file_address) {
-        munmap(m_file_address, m_file_stat.st_size);
-        m_file_address = nullptr;
+bool http_conn::sync_read_block() {
+    if (m_read_chain.empty()) {
+        return false;
     }
+    buffer_chain::block& b = m_read_chain.at(m_read_block);
+    m_read_buf = b.data;
+    m_read_idx = b.end;
+    return true;
 }
 
 /**
- * @brief 向写缓冲区添加格式化响应数据（支持类似 printf 的格式化方式）
+ * @brief 当前块中已没有完整的行时转到下一块
+ *
+ * 块中剩下的是一行的开头（残行），而后面还有数据或当前块已满时，把残行挪到新块开头，
+ * 保证每一行都完整地落在同一块内，已解析的行留在原处，指向它们的指针仍然有效
  *
- * @param format 格式字符串
- * @return 成功添加返回 true，缓冲区满或出错返回 false
+ * @return 没有可解析的后续数据、残行超过一块或读缓冲链已满时返回 false
  */
-bool http_conn::add_response(const char* format, ...) {
-    if (m_write_idx >= WRITE_BUFFER_SIZE) {
+bool http_conn::next_read_block() {
+    bool has_next = m_read_block + 1 < m_read_chain.count();
+    if (!has_next && !m_read_chain.full(m_read_block)) {
+        return false;
+    }
+
+    if (m_start_line < m_read_idx) {
+        if (m_read_idx - m_start_line >= m_read_chain.capacity() ||
+            !m_read_chain.carry_over(m_read_block, m_start_line)) {
+            return false;
+        }
+    } else if (!has_next) {
         return false;
     }
 
-    va_list arg_list;
-    va_start(arg_list, format);
+    m_read_block++;
+    sync_read_block();
+    m_start_line = m_checked_idx = m_read_chain.at(m_read_block).begin;
+    return true;
+}
+
+/**
+ * @brief 释放本批响应引用的文件，没有被缓存或已被淘汰的文件在最后一个引用释放时解除映射、关闭描述符
+ */
+void http_conn::unmap() {
+    // 推迟到下一批的请求还要用它的文件，连接关闭时由 release 释放
+    if (NO_REQUEST == m_deferred) {
+        m_file.reset();
+    }
+    m_response.reset();
+    if (!m_multipart.empty()) {
+        std::string().swap(m_multipart);
+    }
+    for (int i = 0; i < m_file_count; ++i) {
+        m_files[i].reset();
+    }
+    m_file_count = 0;
+}
+
+/**
+ * @brief 设置 TCP_CORK，塞住时内核只发送满长度的报文段，拔出时立即发送剩余数据
+ */
+void http_conn::set_cork(bool on) {
+    if (m_corked == on) {
+        return;
+    }
+    int val = on ? 1 : 0;
+    setsockopt(m_sockfd, IPPROTO_TCP, TCP_CORK, &val, sizeof(val));
+    m_corked = on;
+}
 
-    // vsnprintf 的返回值是如果缓冲区足够大，本应该写入的字符总数（不包括结尾的 '\0'）
-    int len = vsnprintf(m_write_idx + m_write_buf, WRITE_BUFFER_SIZE - 1 - m_write_idx, format, arg_list);
-    // 检查是否发生截断
-    if (len >= (WRITE_BUFFER_SIZE - 1 - m_write_idx)) {
-        va_end(arg_list);
+/**
+ * @brief 向写缓冲区追加一段字节
+ *
+ * @return 成功添加返回 true，缓冲区剩余空间不足时不写入并返回 false
+ */
+bool http_conn::add_bytes(const char* data, size_t len) {
+    if (len > (size_t)(WRITE_BUFFER_SIZE - m_write_idx)) {
         return false;
     }
+    memcpy(m_write_buf + m_write_idx, data, len);
     m_write_idx += len;
-    va_end(arg_list);
-
-    LOG_INFO("response:%s", m_write_buf);
+    return true;
+}
 
+/**
+ * @brief 以十进制追加一个非负整数
+ */
+bool http_conn::add_uint(uint64_t value) {
+    if (WRITE_BUFFER_SIZE - m_write_idx < header_writer::MAX_UINT_DIGITS) {
+        return false;
+    }
+    m_write_idx += header_writer::format_uint(m_write_buf + m_write_idx, value);
     return true;
 }
 
@@ -743,19 +1413,20 @@ bool http_conn::add_response(const char* format, ...) {
  * @brief 添加正文内容到响应中
  *
  * @param content 要添加的正文字符串
- * @return 成功添加返回 true，缓冲区满或出错返回 false
+ * @return 成功添加返回 true，缓冲区满返回 false
  */
-bool http_conn::add_content(const char* content) { return add_response("%s", content); }
+bool http_conn::add_content(const char* content) { return add_bytes(content, strlen(content)); }
 
 /**
- * @brief 添加响应状态行（HTTP 协议版本 + 状态码 + 状态描述）
+ * @brief 添加预先拼好的响应状态行，后接 Date 响应头
  *
  * @param status 状态码（如 200、404）
- * @param title 状态描述（如 OK、Not Found）
  * @return 成功添加返回 true，失败返回 false
  */
-bool http_conn::add_status_line(int status, const char* title) {
-    return add_response("%s %d %s\r\n", "HTTP/1.1", status, title);
+bool http_conn::add_status_line(int status) {
+    m_status = status;
+    m_body_bytes = 0;
+    return add_bytes(header_writer::status_line(status)) && add_bytes(header_writer::date());
 }
 
 /**
@@ -764,7 +1435,7 @@ bool http_conn::add_status_line(int status, const char* title) {
  * @param content_length 正文长度
  * @return 成功添加返回 true，失败返回 false
  */
-bool http_conn::add_headers(int content_len) {
+bool http_conn::add_headers(off_t content_len) {
     return add_content_length(content_len) && add_content_type() && add_linger() && add_blank_line();
 }
 
@@ -773,7 +1444,7 @@ bool http_conn::add_headers(int content_len) {
  *
  * @return 成功添加返回 true，失败返回 false
  */
-bool http_conn::add_content_type() { return add_response("Content-Type:%s\r\n", "text/html"); }
+bool http_conn::add_content_type() { return add_bytes("Content-Type:text/html\r\n"); }
 
 /**
  * @brief 添加 Content-Length 字段到响应头
@@ -781,18 +1452,21 @@ bool http_conn::add_content_type() { return add_response("Content-Type:%s\r\n",
  * @param content_length 正文长度
  * @return 成功添加返回 true，失败返回 false
  */
-bool http_conn::add_content_length(int content_len) { return add_response("Content-Length:%d\r\n", content_len); }
+bool http_conn::add_content_length(off_t content_len) {
+    m_body_bytes = content_len;
+    return add_bytes("Content-Length:") && add_uint(content_len) && add_bytes("\r\n");
+}
 
 /**
  * @brief 添加 Connection 字段到响应头，控制是否保持连接（keep-alive 或 close）
  *
  * @return 成功添加返回 true，失败返回 false
  */
-bool http_conn::add_linger() { return add_response("Connection:%s\r\n", (m_linger == true) ? "keep-alive" : "close"); }
+bool http_conn::add_linger() { return add_bytes(m_linger ? "Connection:keep-alive\r\n" : "Connection:close\r\n"); }
 
 /**
  * @brief 添加空行分隔符，标志 HTTP 头部结束
  *
  * @return 成功添加返回 true，失败返回 false
  */
-bool http_conn::add_blank_line() { return add_response("%s", "\r\n"); }
+bool http_conn::add_blank_line() { return add_bytes("\r\n"); }
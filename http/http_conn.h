@@ -6,6 +6,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdarg.h>
@@ -14,6 +15,7 @@
 #include <string.h>
 #include <sys/epoll.h>
 #include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -21,23 +23,49 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <map>
+#include <string>
 
 #include "../CGImysql/sql_connection_pool.h"
+#include "../cache/file_cache.h"
+#include "../cache/gzip_cache.h"
+#include "../cache/response_cache.h"
 #include "../lock/locker.h"
 #include "../log/log.h"
+#include "../memorypool/buffer_chain.h"
+#include "../memorypool/buffer_pool.h"
+#include "../reactor/completion_queue.h"
 #include "../timer/lst_timer.h"
+#include "cache_policy.h"
+#include "header_writer.h"
+#include "http_parser.h"
 
 class http_conn {
    public:
     /** @brief 文件名最大长度 */
     static const int FILENAME_LEN = 200;
 
-    /** @brief 读缓冲区大小 */
-    static const int READ_BUFFER_SIZE = 2048;
+    /** @brief 读缓冲块大小，请求行和单个请求头都不能跨块，因此也是一行的长度上限 */
+    static const int READ_BUFFER_SIZE = 4096;
 
-    /** @brief 写缓冲区大小 */
-    static const int WRITE_BUFFER_SIZE = 1024;
+    /** @brief 写缓冲区大小，流水线中同一批响应的响应头依次写入 */
+    static const int WRITE_BUFFER_SIZE = 2048;
+
+    /** @brief 一批最多合并发送的流水线响应数 */
+    static const int MAX_PIPELINE = 16;
+
+    /** @brief 单个响应写入写缓冲区的最大字节数（状态行、响应头和错误页面正文），剩余空间不足时不再合并 */
+    static const int MAX_RESPONSE_HEAD = 512;
+
+    /** @brief Range 请求合并后最多的范围数，超过时忽略 Range 返回完整内容 */
+    static const int MAX_RANGES = 8;
+
+    /** @brief 单个响应最多占用的 iovec 数：多段范围响应为响应头、每段的部分头与内容以及结束分隔行 */
+    static const int MAX_RESPONSE_IOV = 2 * MAX_RANGES + 2;
+
+    /** @brief 一批响应的 iovec 总数，普通响应占两项，保证合并了 MAX_PIPELINE - 1 个普通响应后仍能放下一个多段范围响应 */
+    static const int MAX_IOV = 2 * MAX_PIPELINE + MAX_RESPONSE_IOV;
 
     /** @brief HTTP 请求方法类 */
     enum METHOD { GET = 0, POST, HEAD, PUT, DELETE, TRACE, OPTIONS, CONNECT, PATCH };
@@ -64,26 +92,67 @@ class http_conn {
         LINE_OPEN     // 当前行尚未完全读取
     };
 
+    /** @brief write 的结果，决定调用方接下来如何处理连接 */
+    enum WRITE_RESULT {
+        WRITE_CLOSE = 0,  // 写入失败或不再保持连接，由调用方关闭
+        WRITE_WAIT,       // 已注册可写或可读事件，调用方不能再操作连接
+        WRITE_CONTINUE    // 本批响应已全部发出，读缓冲链中还有流水线请求，未注册事件，由调用方接着处理
+    };
+
    public:
-    http_conn() {}
+    http_conn()
+        : m_read_buf(NULL),
+          m_read_chain(&m_block_pool),
+          m_write_buf(NULL),
+          m_file_count(0) {}
     ~http_conn() {}
 
    public:
     /** @brief 初始化连接对象（带多个参数的版本）*/
-    void init(int sockfd, const sockaddr_in& addr, char* root, int TRIGMode, int close_log, string user, string passwd,
-              string sqlname);
+    void init(int epollfd, completion_queue* completion, int sockfd, const sockaddr_in& addr, char* root, int TRIGMode,
+              int close_log, int zerocopy);
 
     /** @brief 关闭客户端连接 */
     void close_conn(bool real_close = true);
 
+    /** @brief 连接关闭后归还读缓冲块、写缓冲区并减少连接计数，重复调用无副作用 */
+    void release();
+
     /** @brief 处理客户端请求，调用读写操作 */
     void process();
 
+    /** @brief 解析读缓冲链中所有完整的请求并生成一批响应，不涉及 epoll */
+    int handle_request();
+
+    /** @brief 读缓冲链中恰好是一个命中响应缓存的 GET 请求时直接准备好响应，由调用方立即发送 */
+    bool serve_cached();
+
+    /** @brief 把由其它 I/O 后端读到的数据追加到读缓冲区 */
+    bool append_read(const char* data, int len);
+
+    /** @brief 记录已发送的字节数并调整 iovec，全部发送完毕返回 true */
+    bool advance_send(ssize_t bytes);
+
+    /** @brief 一批响应发送完毕后的收尾，需要保持连接时重置响应状态并返回 true */
+    bool finish_response();
+
+    /** @brief 释放本批响应引用的文件 */
+    void unmap();
+
+    /** @brief 读缓冲区中是否有尚未处理完的请求数据，用于选择请求头超时还是空闲超时 */
+    bool in_request() const { return !m_read_chain.empty(); }
+
+    /** @brief 待发送响应中第一个尚未发完的 iovec */
+    struct iovec* get_iovec() { return m_iv + m_iv_idx; }
+
+    /** @brief 待发送响应中尚未发完的 iovec 数量 */
+    int get_iov_count() { return m_iv_count - m_iv_idx; }
+
     /** @brief 从客户端 socket 一次性读取数据到读缓冲区 */
     bool read_once();
 
-    /** @brief 响应客户请求，将缓冲区中的数据写入 socket */
-    bool write();
+    /** @brief 响应客户请求，将缓冲区中的数据写入 socket，返回调用方接下来的处理方式 */
+    WRITE_RESULT write();
 
     /**
      * @brief 获取客户端的地址信息
@@ -92,17 +161,55 @@ class http_conn {
      */
     sockaddr_in* get_address() { return &m_address; }
 
+    /** @brief 当前请求的零拷贝视图，解析完请求头后有效，生成响应后失效 */
+    const http_request_view& get_request() const { return m_request; }
+
+    /** @brief 连接的 socket 描述符，工作窃取模式下据此选择工作线程 */
+    int get_sockfd() const { return m_sockfd; }
+
     /** @brief 初始化 MySQL 用户验证结果，加载用户账户信息到内存 */
     void initmysql_result(connection_pool* connPool);
 
+    /** @brief reactor 模式下工作线程处理完读写后调用，把结果回报给所属 reactor */
+    void complete();
+
     /** @brief 用于定时器相关控制 */
-    int timer_flag;  // 定时器标志位，用于标识连接状态或定时器行为（如超时、关闭）
-    int improv;      // 是否对定时器行为进行干预的标记，用于同步定时器与工作线程
+    int timer_flag;  // 定时器标志位，工作线程读写失败时置 1，由 reactor 关闭连接并删除定时器
 
    private:
     /** @brief 内部初始化函数，重置连接对象的所有状态和变量 */
     void init();
 
+    /** @brief 重置请求解析状态 */
+    void reset_request();
+
+    /** @brief 丢弃已处理完的请求数据，准备解析下一个流水线请求 */
+    void next_request();
+
+    /** @brief 重置写缓冲区与 iovec */
+    void reset_response();
+
+    /** @brief 把一段待发送数据追加到本批响应的 iovec 中 */
+    void add_iovec(char* base, size_t len);
+
+    /** @brief 把文件中的一段作为 sendfile 发送的一段追加到本批响应中 */
+    void add_file(int fd, off_t offset, off_t len);
+
+    /** @brief 把当前文件中的一段追加到本批响应中，零拷贝模式下用 sendfile，否则指向映射 */
+    void add_body(off_t offset, off_t len);
+
+    /** @brief 条件请求的校验器与文件匹配，客户端缓存仍然有效时返回 true */
+    bool not_modified();
+
+    /** @brief 解析当前请求的 Range，返回值同 http_parser::parse_range，没有 Range 或 If-Range 不匹配时返回 -1 */
+    int parse_ranges(byte_range* ranges);
+
+    /** @brief 生成 206 响应，单个范围直接发送该段，多个范围生成 multipart/byteranges */
+    bool add_partial(const byte_range* ranges, int count, int resp_start, const std::string& cache_control);
+
+    /** @brief 塞住或拔出 socket（TCP_CORK） */
+    void set_cork(bool on);
+
     /** @brief 处理客户端发送的 HTTP 请求数据，解析请求行、请求头和请求体 */
     HTTP_CODE process_read();
 
@@ -131,26 +238,33 @@ class http_conn {
     /** @brief 解析一行 HTTP 请求数据，判断该行是否完整 */
     LINE_STATUS parse_line();
 
-    /** @brief 取消内存映射，释放由 mmap 映射的文件资源 */
-    void unmap();
+    /** @brief 让 m_read_buf / m_read_idx 指向当前解析的块，读缓冲链为空时返回 false */
+    bool sync_read_block();
 
-    /** @brief 向写缓冲区添加格式化响应数据 */
-    bool add_response(const char* format, ...);
+    /** @brief 当前块中已没有完整的行时转到下一块，必要时把残行挪到新块开头 */
+    bool next_read_block();
+
+    /** @brief 向写缓冲区追加一段字节 */
+    bool add_bytes(const char* data, size_t len);
+    bool add_bytes(std::string_view data) { return add_bytes(data.data(), data.size()); }
+
+    /** @brief 以十进制追加一个非负整数 */
+    bool add_uint(uint64_t value);
 
     /** @brief 添加正文内容到响应中 */
     bool add_content(const char* content);
 
-    /** @brief 添加响应状态行 */
-    bool add_status_line(int status, const char* title);
+    /** @brief 添加响应状态行与 Date 响应头 */
+    bool add_status_line(int status);
 
     /** @brief 添加 HTTP 响应头 */
-    bool add_headers(int content_length);
+    bool add_headers(off_t content_length);
 
     /** @brief 添加 Content-Type 到响应头 */
     bool add_content_type();
 
     /** @brief 添加 Content-Length 字段到响应头 */
-    bool add_content_length(int content_length);
+    bool add_content_length(off_t content_length);
 
     /** @brief 添加 Connection 字段到响应头 */
     bool add_linger();
@@ -158,12 +272,28 @@ class http_conn {
     /** @brief 添加空行分隔符 */
     bool add_blank_line();
 
+    /** @brief 按采样率决定是否记录本响应，记录时向访问日志写一行 */
+    void log_access(std::string_view method, std::string_view path, std::string_view version, int status,
+                    off_t bytes);
+
    public:
-    /** @brief epoll 文件描述符，用于 I/O 多路复用 */
-    static int m_epollfd;
+    /** @brief 连接所属 reactor 的 epoll 文件描述符，用于 I/O 多路复用 */
+    int m_epollfd;
 
-    /** @brief 当前用户连接数 */
-    static int m_user_count;
+    /** @brief 连接所属 reactor 的完成通知队列 */
+    completion_queue* m_completion;
+
+    /** @brief 当前用户连接数（多个 reactor 线程并发修改）*/
+    static std::atomic<int> m_user_count;
+
+    /** @brief 所有连接共享的写缓冲区池 */
+    static buffer_pool m_buf_pool;
+
+    /** @brief 所有连接共享的读缓冲块池 */
+    static buffer_pool m_block_pool;
+
+    /** @brief 访问日志采样率，每 N 个响应记录一个，0 为不记录 */
+    static int m_access_sample;
 
     /** @brief MySQL 连接句柄 */
     MYSQL* mysql;
@@ -178,20 +308,29 @@ class http_conn {
     /** @brief 客户端地址结构体 */
     sockaddr_in m_address;
 
-    /** @brief 读缓冲区 */
-    char m_read_buf[READ_BUFFER_SIZE];
+    /** @brief 当前解析的读缓冲块 */
+    char* m_read_buf;
 
-    /** @brief 已读取字节数 */
+    /** @brief 读缓冲链，读到数据时才从块池中取块，请求处理完即归还 */
+    buffer_chain m_read_chain;
+
+    /** @brief 当前解析的块在读缓冲链中的下标 */
+    int m_read_block;
+
+    /** @brief 当前块已读取字节数 */
     long m_read_idx;
 
-    /** @brief 已检查字节数 */
+    /** @brief 当前块已检查字节数 */
     long m_checked_idx;
 
-    /** @brief 当前行起始位置 */
+    /** @brief 当前行在当前块中的起始位置 */
     int m_start_line;
 
-    /** @brief 写缓冲区 */
-    char m_write_buf[WRITE_BUFFER_SIZE];
+    /** @brief 最近一个完整行的行尾位置（原 '\r' 处）*/
+    long m_line_end;
+
+    /** @brief 写缓冲区，连接建立时从写缓冲区池中取出 */
+    char* m_write_buf;
 
     /** @brief 已写入字节数 (当前写入位置) */
     int m_write_idx;
@@ -214,56 +353,87 @@ class http_conn {
     /** @brief 请求主机 */
     char* m_host;
 
+    /** @brief 请求行与请求头的零拷贝视图，指向读缓冲区 */
+    http_request_view m_request;
+
     /** @brief 请求体长度 */
     long m_content_length;
 
-    /** @brief 是否保持连接 */
+    /** @brief 当前请求是否要求保持连接 */
     bool m_linger;
 
-    /** @brief 映射文件地址 */
-    char* m_file_address;
+    /** @brief 本批响应发送完后是否保持连接，取最后一个响应的 m_linger */
+    bool m_keep_alive;
+
+    /** @brief 已解析完但写缓冲区放不下它的响应、推迟到下一批生成的请求的解析结果，NO_REQUEST 表示没有 */
+    HTTP_CODE m_deferred;
+
+    /** @brief 当前请求的文件，由文件缓存提供 */
+    file_ref m_file;
+
+    /** @brief 待发送的各段，普通响应占用响应头和文件两项；文件段的 iov_base 不用，只用 iov_len 记录剩余长度 */
+    struct iovec m_iv[MAX_IOV];
 
-    /** @brief 文件状态信息 */
-    struct stat m_file_stat;
+    /** @brief 各段对应的文件描述符，内存段为 -1 */
+    int m_iv_fd[MAX_IOV];
 
-    /** @brief 用于 writev 的结构数组 */
-    struct iovec m_iv[2];
+    /** @brief 文件段下一次 sendfile 的文件偏移 */
+    off_t m_iv_off[MAX_IOV];
 
     /** @brief writev 使用的 iovec 数量 */
     int m_iv_count;
 
+    /** @brief 第一个尚未发完的 iovec 下标 */
+    int m_iv_idx;
+
+    /** @brief 是否用 sendfile 发送静态文件，与文件缓存的打开方式一致 */
+    int m_zerocopy;
+
+    /** @brief 本批响应引用的文件，全部发送完后统一释放 */
+    file_ref m_files[MAX_PIPELINE];
+
+    /** @brief 本批响应引用的文件数 */
+    int m_file_count;
+
+    /** @brief 由响应缓存直接应答时引用的缓存响应，发送完后释放 */
+    response_ref m_response;
+
+    /** @brief 多段范围响应的分隔行与部分头，生成后不再修改，iovec 直接指向它；一批响应中最多一个 */
+    std::string m_multipart;
+
+    /** @brief socket 当前是否已塞住 */
+    bool m_corked;
+
     /** @brief 是否启用 CGI 模式 */
     int cgi;
 
     /** @brief 存储 POST 请求数据 */
     char* m_string;
 
+    /** @brief 跨块的请求体拼接后的副本 */
+    std::string m_body;
+
     /** @brief 待发送字节数 */
-    int bytes_to_send;
+    int64_t bytes_to_send;
 
     /** @brief 已发送字节数 */
-    int bytes_have_send;
+    int64_t bytes_have_send;
 
     /** @brief 网站根目录路径 */
     char* doc_root;
 
-    /** @brief 用户账户信息映射（用户名和密码） */
-    map<string, string> m_users;
-
     /** @brief 触发模式（边沿触发 ET / 水平触发 LT） */
     int m_TRIGMode;
 
     /** @brief 是否关闭日志记录 */
     int m_close_log;
 
-    /** @brief 数据库用户名 */
-    char sql_user[100];
-
-    /** @brief 数据库密码 */
-    char sql_passwd[100];
+    /** @brief 最近一次读到数据的时间（CLOCK_MONOTONIC 纳秒），访问日志的耗时从这里算起 */
+    uint64_t m_read_ns;
 
-    /** @brief 数据库名称 */
-    char sql_name[100];
+    /** @brief 当前响应的状态码与正文字节数，供访问日志使用 */
+    int m_status;
+    off_t m_body_bytes;
 };
 
 #endif  // !HTTP_CONNECTION_H
\ No newline at end of file
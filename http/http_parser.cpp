@@ -0,0 +1,363 @@
+#include "http_parser.h"
+
+#include <string.h>
+#include <strings.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HTTP_PARSER_X86 1
+#endif
+
+static const char* find_eol_scalar(const char* p, const char* end) {
+    for (; p < end; ++p) {
+        if (*p == '\r' || *p == '\n') {
+            return p;
+        }
+    }
+    return end;
+}
+
+static const char* find_any_scalar(const char* p, const char* end, const char* set, int set_len) {
+    for (; p < end; ++p) {
+        if (memchr(set, *p, set_len)) {
+            return p;
+        }
+    }
+    return end;
+}
+
+#ifdef HTTP_PARSER_X86
+
+// SSE2 是 x86-64 的基线指令集，无需检测
+static const char* find_eol_sse2(const char* p, const char* end) {
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    for (; p + 16 <= end; p += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, cr), _mm_cmpeq_epi8(chunk, lf)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return find_eol_scalar(p, end);
+}
+
+__attribute__((target("avx2"))) static const char* find_eol_avx2(const char* p, const char* end) {
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    for (; p + 32 <= end; p += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)p);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, cr), _mm256_cmpeq_epi8(chunk, lf)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return find_eol_sse2(p, end);
+}
+
+__attribute__((target("sse4.2"))) static const char* find_any_sse42(const char* p, const char* end, const char* set,
+                                                                     int set_len) {
+    char set_buf[16] = {0};
+    memcpy(set_buf, set, set_len);
+    const __m128i needles = _mm_loadu_si128((const __m128i*)set_buf);
+    for (; p + 16 <= end; p += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        int idx = _mm_cmpestri(needles, set_len, chunk, 16,
+                               _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+        if (idx < 16) {
+            return p + idx;
+        }
+    }
+    return find_any_scalar(p, end, set, set_len);
+}
+
+#endif  // HTTP_PARSER_X86
+
+typedef const char* (*find_eol_func)(const char*, const char*);
+typedef const char* (*find_any_func)(const char*, const char*, const char*, int);
+
+// 程序启动时按 CPU 支持的指令集选定实现
+static find_eol_func choose_find_eol() {
+#ifdef HTTP_PARSER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return find_eol_avx2;
+    }
+    return find_eol_sse2;
+#else
+    return find_eol_scalar;
+#endif
+}
+
+static find_any_func choose_find_any() {
+#ifdef HTTP_PARSER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        return find_any_sse42;
+    }
+#endif
+    return find_any_scalar;
+}
+
+static const find_eol_func s_find_eol = choose_find_eol();
+static const find_any_func s_find_any = choose_find_any();
+
+const char* http_parser::find_eol(const char* begin, const char* end) { return s_find_eol(begin, end); }
+
+const char* http_parser::find_any(const char* begin, const char* end, const char* set, int set_len) {
+    return s_find_any(begin, end, set, set_len);
+}
+
+// 读取一个不超过 18 位的十进制数，没有数字时返回 false
+static bool parse_offset(const char*& p, const char* end, off_t& out) {
+    const char* start = p;
+    out = 0;
+    while (p < end && *p >= '0' && *p <= '9' && p - start < 18) {
+        out = out * 10 + (*p - '0');
+        ++p;
+    }
+    return p > start && (p == end || *p < '0' || *p > '9');
+}
+
+long http_parser::parse_content_length(std::string_view value, long max) {
+    const char* p = value.data();
+    const char* end = p + value.size();
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t')) {
+        --end;
+    }
+    if (p == end) {
+        return -1;
+    }
+    long n = 0;
+    for (; p < end; ++p) {
+        if (*p < '0' || *p > '9') {
+            return -1;
+        }
+        n = n * 10 + (*p - '0');
+        if (n > max) {
+            return -1;
+        }
+    }
+    return n;
+}
+
+int http_parser::parse_range(std::string_view value, off_t size, byte_range* ranges, int max) {
+    // 合并前最多接受的范围数，防止大量细碎的范围
+    const int MAX_SPECS = 32;
+    byte_range specs[MAX_SPECS];
+    int count = 0;
+    int parsed = 0;  // 语法正确的范围数，包括不可满足的
+
+    const char* p = value.data();
+    const char* end = p + value.size();
+    if (value.size() < 6 || strncasecmp(p, "bytes=", 6) != 0) {
+        return -1;
+    }
+    p += 6;
+
+    while (p < end) {
+        p = skip_ws(p, end);
+        if (p < end && *p == ',') {
+            ++p;
+            continue;
+        }
+        if (p == end) {
+            break;
+        }
+
+        off_t first, last;
+        if (*p == '-') {
+            // 后缀范围：最后 n 个字节
+            ++p;
+            off_t suffix;
+            if (!parse_offset(p, end, suffix)) {
+                return -1;
+            }
+            if (suffix == 0 || size == 0) {
+                first = -1;
+            } else {
+                first = suffix >= size ? 0 : size - suffix;
+            }
+            last = size - 1;
+        } else {
+            if (!parse_offset(p, end, first) || p == end || *p != '-') {
+                return -1;
+            }
+            ++p;
+            if (p < end && *p >= '0' && *p <= '9') {
+                if (!parse_offset(p, end, last) || last < first) {
+                    return -1;
+                }
+                if (last >= size) {
+                    last = size - 1;
+                }
+            } else {
+                last = size - 1;
+            }
+            // 起点超出文件末尾的范围不可满足
+            if (first >= size) {
+                first = -1;
+            }
+        }
+
+        p = skip_ws(p, end);
+        if (p < end && *p != ',') {
+            return -1;
+        }
+        ++parsed;
+        if (first < 0) {
+            continue;
+        }
+        if (count == MAX_SPECS) {
+            return -1;
+        }
+        specs[count].first = first;
+        specs[count].last = last;
+        ++count;
+    }
+    // "bytes=" 之后没有任何范围是语法错误，不能当作全部不可满足而返回 416
+    if (0 == parsed) {
+        return -1;
+    }
+
+    // 插入排序后合并重叠或相邻的范围
+    for (int i = 1; i < count; ++i) {
+        byte_range r = specs[i];
+        int j = i - 1;
+        while (j >= 0 && specs[j].first > r.first) {
+            specs[j + 1] = specs[j];
+            --j;
+        }
+        specs[j + 1] = r;
+    }
+    int merged = 0;
+    for (int i = 0; i < count; ++i) {
+        if (merged > 0 && specs[i].first <= ranges[merged - 1].last + 1) {
+            if (specs[i].last > ranges[merged - 1].last) {
+                ranges[merged - 1].last = specs[i].last;
+            }
+            continue;
+        }
+        if (merged == max) {
+            return -1;
+        }
+        ranges[merged++] = specs[i];
+    }
+    return merged;
+}
+
+bool http_parser::etag_match(std::string_view list, std::string_view etag) {
+    const char* p = list.data();
+    const char* end = p + list.size();
+    while (p < end) {
+        p = skip_ws(p, end);
+        if (p < end && *p == ',') {
+            ++p;
+            continue;
+        }
+        if (p == end) {
+            break;
+        }
+        if (*p == '*') {
+            return true;
+        }
+        if (end - p >= 2 && p[0] == 'W' && p[1] == '/') {
+            p += 2;
+        }
+        // 实体标签是带引号的字符串，其中不含引号
+        if (p == end || *p != '"') {
+            return false;
+        }
+        const char* close = (const char*)memchr(p + 1, '"', end - p - 1);
+        if (!close) {
+            return false;
+        }
+        if (std::string_view(p, close + 1 - p) == etag) {
+            return true;
+        }
+        p = close + 1;
+    }
+    return false;
+}
+
+bool http_parser::accepts_gzip(std::string_view value) {
+    // -1 表示未出现
+    int gzip = -1, star = -1;
+    const char* p = value.data();
+    const char* end = p + value.size();
+    while (p < end) {
+        p = skip_ws(p, end);
+        const char* item_end = find_any(p, end, ",", 1);
+        const char* semi = find_any(p, item_end, ";", 1);
+        const char* name_end = semi;
+        while (name_end > p && (name_end[-1] == ' ' || name_end[-1] == '\t')) {
+            --name_end;
+        }
+        std::string_view name(p, name_end - p);
+
+        // q=0、q=0.0 等表示不接受，其它取值都视为接受
+        bool accept = true;
+        if (semi != item_end) {
+            const char* q = skip_ws(semi + 1, item_end);
+            if (item_end - q >= 2 && (q[0] == 'q' || q[0] == 'Q') && q[1] == '=') {
+                q += 2;
+                accept = false;
+                for (; q < item_end && *q != ' ' && *q != '\t' && *q != ';'; ++q) {
+                    if (*q != '0' && *q != '.') {
+                        accept = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (iequals(name, "gzip") || iequals(name, "x-gzip")) {
+            gzip = accept;
+        } else if (name == "*") {
+            star = accept;
+        }
+        p = item_end == end ? end : item_end + 1;
+    }
+    return gzip >= 0 ? gzip > 0 : star > 0;
+}
+
+time_t http_parser::parse_http_date(std::string_view value) {
+    static const char* months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+    // Sun, 06 Nov 1994 08:49:37 GMT
+    if (value.size() != 29 || value[3] != ',' || value.substr(25) != " GMT") {
+        return -1;
+    }
+    const char* p = value.data();
+    auto num = [p](int pos, int len) {
+        int n = 0;
+        for (int i = 0; i < len; ++i) {
+            char c = p[pos + i];
+            if (c < '0' || c > '9') {
+                return -1;
+            }
+            n = n * 10 + (c - '0');
+        }
+        return n;
+    };
+
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_mday = num(5, 2);
+    tm.tm_year = num(12, 4) - 1900;
+    tm.tm_hour = num(17, 2);
+    tm.tm_min = num(20, 2);
+    tm.tm_sec = num(23, 2);
+    tm.tm_mon = -1;
+    for (int i = 0; i < 12; ++i) {
+        if (strncmp(p + 8, months[i], 3) == 0) {
+            tm.tm_mon = i;
+        }
+    }
+    if (tm.tm_mday < 1 || tm.tm_year < 0 || tm.tm_hour < 0 || tm.tm_min < 0 || tm.tm_sec < 0 || tm.tm_mon < 0 ||
+        p[16] != ' ' || p[19] != ':' || p[22] != ':') {
+        return -1;
+    }
+    return timegm(&tm);
+}
@@ -0,0 +1,138 @@
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include <string_view>
+
+#include "header_table.h"
+
+/** @brief 一个字节范围，闭区间 [first, last] */
+struct byte_range {
+    off_t first;
+    off_t last;
+};
+
+/**
+ * @brief 向量化的字符扫描
+ *
+ * x86-64 上按运行时检测到的指令集选择实现：找行尾用 AVX2 每次 32 字节（否则 SSE2 每次 16 字节），
+ * 找分隔符用 SSE4.2 的 pcmpestri 每次 16 字节；其它平台使用逐字节的标量实现。
+ * 只读取 [begin, end) 范围内的字节，不会越界。
+ */
+class http_parser {
+   public:
+    /** @brief 查找第一个 '\r' 或 '\n'，找不到返回 end */
+    static const char* find_eol(const char* begin, const char* end);
+
+    /** @brief 查找第一个属于 set 中任一字符的位置（set 最多 16 个字符），找不到返回 end */
+    static const char* find_any(const char* begin, const char* end, const char* set, int set_len);
+
+    /** @brief 跳过开头的空格和制表符 */
+    static const char* skip_ws(const char* begin, const char* end) {
+        while (begin < end && (*begin == ' ' || *begin == '\t')) {
+            ++begin;
+        }
+        return begin;
+    }
+
+    /** @brief 大小写不敏感地比较，长度不同即不相等 */
+    static bool iequals(std::string_view a, std::string_view b) {
+        return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+    }
+
+    /** @brief 解析 Content-Length：只接受十进制数字（允许末尾空白），超过 max 或格式不对时返回 -1 */
+    static long parse_content_length(std::string_view value, long max);
+
+    /**
+     * @brief 解析 Range 请求头（bytes=...），按起点排序并合并重叠或相邻的范围
+     *
+     * @param size   文件大小
+     * @param ranges 输出合并后的范围，已截断到文件末尾
+     * @param max    最多接受的范围数
+     * @return 范围数；全部不可满足时返回 0；语法错误（包括一个范围都没有）、单位不是 bytes 或合并后超过 max 时
+     *         返回 -1，调用方应忽略 Range
+     */
+    static int parse_range(std::string_view value, off_t size, byte_range* ranges, int max);
+
+    /** @brief If-None-Match 的实体标签列表中是否有与 etag 弱比较相等的（忽略 W/ 前缀），"*" 匹配任何实体 */
+    static bool etag_match(std::string_view list, std::string_view etag);
+
+    /** @brief Accept-Encoding 是否接受 gzip：gzip / x-gzip 或未明确排除 gzip 时的 "*"，且 q 不为 0 */
+    static bool accepts_gzip(std::string_view value);
+
+    /** @brief 解析 IMF-fixdate 格式的 HTTP 日期（如 Sun, 06 Nov 1994 08:49:37 GMT），格式不对时返回 -1 */
+    static time_t parse_http_date(std::string_view value);
+};
+
+/** @brief 一个请求头字段，name 与 value 都指向读缓冲区 */
+struct http_header_view {
+    http_header_id id;  // 标准请求头的编号，其它请求头为 HDR_UNKNOWN
+    std::string_view name;
+    std::string_view value;
+};
+
+/**
+ * @brief 请求的零拷贝视图
+ *
+ * 所有字段都直接指向连接的读缓冲区，只在本次请求处理期间有效；连接重置读缓冲区后失效。
+ */
+struct http_request_view {
+    static const int MAX_HEADERS = 32;
+
+    std::string_view method;
+    std::string_view path;
+    std::string_view version;
+    http_header_view headers[MAX_HEADERS];
+    int header_count;
+    signed char index[HDR_COUNT];  // 标准请求头在 headers 中的下标，未出现为 -1
+
+    void clear() {
+        method = path = version = std::string_view();
+        header_count = 0;
+        memset(index, -1, sizeof(index));
+    }
+
+    /** @brief 记录一个请求头，同名的标准请求头只记录第一次出现的；表满时返回 false */
+    bool add(http_header_id id, std::string_view name, std::string_view value) {
+        if (header_count >= MAX_HEADERS) {
+            return false;
+        }
+        if (id != HDR_UNKNOWN && index[id] < 0) {
+            index[id] = (signed char)header_count;
+        }
+        http_header_view& header = headers[header_count++];
+        header.id = id;
+        header.name = name;
+        header.value = value;
+        return true;
+    }
+
+    /** @brief 按编号取标准请求头，O(1)，不存在时返回空视图 */
+    std::string_view header(http_header_id id) const {
+        return index[id] < 0 ? std::string_view() : headers[(int)index[id]].value;
+    }
+
+    /** @brief 标准请求头是否出现 */
+    bool has(http_header_id id) const { return index[id] >= 0; }
+
+    /** @brief 按名称（大小写不敏感）查找请求头，标准请求头查表，其它请求头顺序查找，不存在时返回空视图 */
+    std::string_view header(std::string_view name) const {
+        http_header_id id = header_table::lookup(name);
+        if (id != HDR_UNKNOWN) {
+            return header(id);
+        }
+        for (int i = 0; i < header_count; i++) {
+            if (http_parser::iequals(headers[i].name, name)) {
+                return headers[i].value;
+            }
+        }
+        return std::string_view();
+    }
+};
+
+#endif  // !HTTP_PARSER_H
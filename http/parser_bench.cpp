@@ -0,0 +1,273 @@
+// 请求解析的微基准：parser_bench [轮数]
+//
+// 语料是几种常见浏览器与工具发出的真实请求，依次拼接成流水线。
+// eol 一项只比较找行尾：逐字节扫描与 http_parser::find_eol（按 CPU 选择 AVX2 / SSE2）。
+// request 一项比较完整地切分请求行与请求头：原先 parse_line 逐字节找 \r\n、strpbrk / strspn / strncasecmp
+// 处理字段，与现在 find_eol / find_any 找边界、完美哈希识别请求头并记入零拷贝视图。
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include <string>
+
+#include "http_parser.h"
+
+static const char* corpus[] = {
+    // Chrome 打开页面
+    "GET /judge.html HTTP/1.1\r\n"
+    "Host: 192.168.1.10:9006\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"128\", \"Not;A=Brand\";v=\"24\", \"Google Chrome\";v=\"128\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "sec-ch-ua-platform: \"Windows\"\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) "
+    "Chrome/128.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;q=0.8,"
+    "application/signed-exchange;v=b3;q=0.7\r\n"
+    "Sec-Fetch-Site: none\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-User: ?1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "\r\n",
+    // Chrome 加载页面中的图片
+    "GET /frame.jpg HTTP/1.1\r\n"
+    "Host: 192.168.1.10:9006\r\n"
+    "Connection: keep-alive\r\n"
+    "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) "
+    "Chrome/128.0.0.0 Safari/537.36\r\n"
+    "Accept: image/avif,image/webp,image/apng,image/svg+xml,image/*,*/*;q=0.8\r\n"
+    "Referer: http://192.168.1.10:9006/picture.html\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "If-None-Match: W/\"1f4a2-65f1c2a0\"\r\n"
+    "If-Modified-Since: Fri, 16 Oct 2026 08:00:00 GMT\r\n"
+    "\r\n",
+    // Firefox
+    "GET /video.html HTTP/1.1\r\n"
+    "Host: 192.168.1.10:9006\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:130.0) Gecko/20100101 Firefox/130.0\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Connection: keep-alive\r\n"
+    "Referer: http://192.168.1.10:9006/welcome.html\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "Priority: u=0, i\r\n"
+    "\r\n",
+    // 登录表单
+    "POST /2CGISQL.cgi HTTP/1.1\r\n"
+    "Host: 192.168.1.10:9006\r\n"
+    "Connection: keep-alive\r\n"
+    "Content-Length: 27\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "Origin: http://192.168.1.10:9006\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\n"
+    "User-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_7) AppleWebKit/605.1.15 (KHTML, like Gecko) "
+    "Version/17.5 Safari/605.1.15\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+    "Referer: http://192.168.1.10:9006/log.html\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Accept-Language: zh-CN,zh-Hans;q=0.9\r\n"
+    "\r\n"
+    "user=wcq&password=123456789",
+    // 压测工具
+    "GET /welcome.html HTTP/1.1\r\n"
+    "Host: 127.0.0.1:9006\r\n"
+    "User-Agent: curl/8.5.0\r\n"
+    "Accept: */*\r\n"
+    "\r\n",
+};
+
+// 防止编译器把结果当作无用而优化掉
+static volatile long g_sink;
+
+static const char* find_eol_bytewise(const char* p, const char* end) {
+    for (; p < end; ++p) {
+        if (*p == '\r' || *p == '\n') {
+            return p;
+        }
+    }
+    return end;
+}
+
+template <typename F>
+static long count_lines(const char* begin, const char* end, F find) {
+    long lines = 0;
+    for (const char* p = begin; (p = find(p, end)) < end; p += 2) {
+        ++lines;
+    }
+    return lines;
+}
+
+// 原先的做法：逐字节找 \r\n 并写入 '\0'，再用 strpbrk / strspn / strncasecmp 处理请求行与请求头
+static long parse_old(char* buf, long len) {
+    long fields = 0;
+    long idx = 0;
+    while (idx < len) {
+        long start = idx;
+        while (idx + 1 < len && !(buf[idx] == '\r' && buf[idx + 1] == '\n')) {
+            ++idx;
+        }
+        buf[idx] = buf[idx + 1] = '\0';
+        idx += 2;
+        char* text = buf + start;
+
+        // 请求行
+        char* url = strpbrk(text, " \t");
+        *url++ = '\0';
+        url += strspn(url, " \t");
+        int method = strcasecmp(text, "GET") == 0 ? 0 : strcasecmp(text, "POST") == 0 ? 1 : -1;
+        char* version = strpbrk(url, " \t");
+        *version++ = '\0';
+        version += strspn(version, " \t");
+        fields += method + (strcasecmp(version, "HTTP/1.1") == 0);
+
+        // 请求头
+        long content_length = 0;
+        while (idx < len) {
+            start = idx;
+            while (idx + 1 < len && !(buf[idx] == '\r' && buf[idx + 1] == '\n')) {
+                ++idx;
+            }
+            buf[idx] = buf[idx + 1] = '\0';
+            idx += 2;
+            text = buf + start;
+            if (text[0] == '\0') {
+                break;
+            }
+            if (strncasecmp(text, "Connection:", 11) == 0) {
+                text += 11;
+                text += strspn(text, " \t");
+                fields += strcasecmp(text, "keep-alive") == 0;
+            } else if (strncasecmp(text, "Content-length:", 15) == 0) {
+                text += 15;
+                text += strspn(text, " \t");
+                content_length = atol(text);
+            } else if (strncasecmp(text, "Host:", 5) == 0) {
+                text += 5;
+                text += strspn(text, " \t");
+                fields += text[0];
+            }
+            ++fields;
+        }
+        idx += content_length;
+    }
+    return fields;
+}
+
+// 现在的做法：向量化找边界，请求头经完美哈希得到编号，所有字段记入零拷贝视图
+static long parse_new(const char* buf, long len) {
+    long fields = 0;
+    const char* p = buf;
+    const char* end = buf + len;
+    http_request_view request;
+    while (p < end) {
+        request.clear();
+        const char* eol = http_parser::find_eol(p, end);
+        const char* sp = http_parser::find_any(p, eol, " \t", 2);
+        request.method = std::string_view(p, sp - p);
+        const char* url = http_parser::skip_ws(sp + 1, eol);
+        const char* url_end = http_parser::find_any(url, eol, " \t", 2);
+        request.path = std::string_view(url, url_end - url);
+        const char* version = http_parser::skip_ws(url_end + 1, eol);
+        request.version = std::string_view(version, eol - version);
+        int method = http_parser::iequals(request.method, "GET")    ? 0
+                     : http_parser::iequals(request.method, "POST") ? 1
+                                                                    : -1;
+        fields += method + http_parser::iequals(request.version, "HTTP/1.1");
+        p = eol + 2;
+
+        while (p < end) {
+            eol = http_parser::find_eol(p, end);
+            if (eol == p) {
+                p += 2;
+                break;
+            }
+            const char* colon = http_parser::find_any(p, eol, ":", 1);
+            std::string_view name(p, colon - p);
+            const char* value = http_parser::skip_ws(colon + 1, eol);
+            request.add(header_table::lookup(name), name, std::string_view(value, eol - value));
+            p = eol + 2;
+        }
+        fields += request.header_count + http_parser::iequals(request.header(HDR_CONNECTION), "keep-alive") +
+                  request.header(HDR_HOST)[0];
+        std::string_view length = request.header(HDR_CONTENT_LENGTH);
+        if (!length.empty()) {
+            p += strtol(length.data(), NULL, 10);
+        }
+    }
+    return fields;
+}
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char* argv[]) {
+    long rounds = argc > 1 ? atol(argv[1]) : 200000;
+    if (rounds <= 0) {
+        fprintf(stderr, "usage: %s [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    std::string input;
+    int requests = sizeof(corpus) / sizeof(corpus[0]);
+    for (int i = 0; i < requests; ++i) {
+        input += corpus[i];
+    }
+    const char* begin = input.data();
+    const char* end = begin + input.size();
+    std::string work(input);
+
+    if (parse_old(&work[0], work.size()) != parse_new(begin, input.size())) {
+        fprintf(stderr, "old and new parsers disagree\n");
+        return 1;
+    }
+
+    printf("corpus: %d requests, %zu bytes\n", requests, input.size());
+    printf("%-10s %-10s %12s %12s\n", "test", "impl", "ns/request", "MB/s");
+
+    double start = now_sec();
+    for (long i = 0; i < rounds; ++i) {
+        g_sink = count_lines(begin, end, find_eol_bytewise);
+    }
+    double t = now_sec() - start;
+    printf("%-10s %-10s %12.1f %12.1f\n", "eol", "bytewise", t * 1e9 / rounds / requests,
+           input.size() * rounds / t / 1e6);
+
+    start = now_sec();
+    for (long i = 0; i < rounds; ++i) {
+        g_sink = count_lines(begin, end, http_parser::find_eol);
+    }
+    t = now_sec() - start;
+    printf("%-10s %-10s %12.1f %12.1f\n", "eol", "simd", t * 1e9 / rounds / requests, input.size() * rounds / t / 1e6);
+
+    // 原先的解析会改写缓冲区，两种实现每轮都先复制一份语料，复制的开销相同
+    start = now_sec();
+    for (long i = 0; i < rounds; ++i) {
+        memcpy(&work[0], begin, input.size());
+        g_sink = parse_old(&work[0], work.size());
+    }
+    t = now_sec() - start;
+    printf("%-10s %-10s %12.1f %12.1f\n", "request", "old", t * 1e9 / rounds / requests,
+           input.size() * rounds / t / 1e6);
+
+    start = now_sec();
+    for (long i = 0; i < rounds; ++i) {
+        memcpy(&work[0], begin, input.size());
+        g_sink = parse_new(work.data(), work.size());
+    }
+    t = now_sec() - start;
+    printf("%-10s %-10s %12.1f %12.1f\n", "request", "new", t * 1e9 / rounds / requests,
+           input.size() * rounds / t / 1e6);
+    return 0;
+}
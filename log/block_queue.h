@@ -1,6 +1,8 @@
 /*************************************************************
  *循环数组实现的阻塞队列，m_back = (m_back + 1) % m_max_size;
  *线程安全，每个操作前都要先加互斥锁，操作完后，再解锁
+ *元素以移动方式放入和取出；只在队列由空变为非空且有消费者等待时唤醒一个，
+ *被唤醒的消费者取走元素后队列仍非空时再唤醒下一个
  **************************************************************/
 
 #ifndef BLOCK_QUEUE_H_
@@ -10,7 +12,11 @@
 #include <stdlib.h>
 #include <sys/time.h>
 
+#include <time.h>
+
 #include <iostream>
+#include <utility>
+#include <vector>
 
 #include "../lock/locker.h"
 using namespace std;
@@ -28,6 +34,7 @@ class block_queue {
         m_size = 0;
         m_front = -1;
         m_back = -1;
+        m_waiters = 0;
     }
 
     void clear() {
@@ -117,70 +124,131 @@ class block_queue {
         return tmp;
     }
 
-    // 往队列添加元素，需要将所有使用队列的线程先唤醒
-    // 当有元素 push 进队列，相当于生产者生产了一个元素
-    // 若当前没有线程等待条件变量，则唤醒无意义
-    bool push(const T& item) {
+    // 往队列添加元素，队列满时不等待，直接返回 false
+    bool try_push(const T& item) {
         m_mutex.lock();
         if (m_size >= m_max_size) {
-            m_cond.broadcast();
             m_mutex.unlock();
             return false;
         }
-
         m_back = (m_back + 1) % m_max_size;
         m_array[m_back] = item;
-        m_size++;
+        notify_push(1);
+        m_mutex.unlock();
+        return true;
+    }
 
-        m_cond.broadcast();
+    bool try_push(T&& item) {
+        m_mutex.lock();
+        if (m_size >= m_max_size) {
+            m_mutex.unlock();
+            return false;
+        }
+        m_back = (m_back + 1) % m_max_size;
+        m_array[m_back] = std::move(item);
+        notify_push(1);
         m_mutex.unlock();
         return true;
     }
 
+    // 与 try_push 相同，保留原有接口
+    bool push(const T& item) { return try_push(item); }
+    bool push(T&& item) { return try_push(std::move(item)); }
+
+    // 一次加锁放入多个元素，返回实际放入的个数，放不下的留在 items 中
+    int push_batch(T* items, int count) {
+        m_mutex.lock();
+        int n = m_max_size - m_size < count ? m_max_size - m_size : count;
+        for (int i = 0; i < n; ++i) {
+            m_back = (m_back + 1) % m_max_size;
+            m_array[m_back] = std::move(items[i]);
+        }
+        notify_push(n);
+        m_mutex.unlock();
+        return n;
+    }
+
     // pop 时，如果当前队列没有元素，将会等待条件变量
     bool pop(T& item) {
         m_mutex.lock();
         while (m_size <= 0) {
-            if (!m_cond.wait(m_mutex.get())) {
+            ++m_waiters;
+            bool ok = m_cond.wait(m_mutex.get());
+            --m_waiters;
+            if (!ok) {
                 m_mutex.unlock();
                 return false;
             }
         }
-
-        m_front = (m_front + 1) % m_max_size;
-        item = m_array[m_front];
-        m_size--;
-
+        take(&item, 1);
         m_mutex.unlock();
         return true;
     }
 
     // 增加了超时处理
-    bool pop(T& item, int ms_timeout) {
-        struct timespec t = {0, 0};
-        struct timeval now = {0, 0};
-        gettimeofday(&now, NULL);
+    bool pop(T& item, int ms_timeout) { return pop_batch(&item, 1, ms_timeout) == 1; }
+
+    // 最多等待 ms_timeout 毫秒直到队列非空，一次加锁取出至多 max 个元素，返回取出的个数
+    int pop_batch(T* items, int max, int ms_timeout) {
         m_mutex.lock();
-        if (m_size <= 0) {
-            t.tv_sec = now.tv_sec + ms_timeout / 1000;
-            t.tv_nsec = (ms_timeout % 1000) * 1000;
-            if (!m_cond.timewait(m_mutex.get(), t)) {
-                m_mutex.unlock();
-                return false;
+        if (m_size <= 0 && ms_timeout > 0) {
+            // pthread_cond_timedwait 使用 CLOCK_REALTIME 的绝对时间
+            struct timespec t = {0, 0};
+            clock_gettime(CLOCK_REALTIME, &t);
+            t.tv_sec += ms_timeout / 1000;
+            t.tv_nsec += (long)(ms_timeout % 1000) * 1000000;
+            if (t.tv_nsec >= 1000000000) {
+                t.tv_sec += 1;
+                t.tv_nsec -= 1000000000;
+            }
+            while (m_size <= 0) {
+                ++m_waiters;
+                bool ok = m_cond.timewait(m_mutex.get(), t);
+                --m_waiters;
+                if (!ok) {
+                    break;
+                }
             }
         }
+        int n = m_size < max ? m_size : max;
+        take(items, n);
+        m_mutex.unlock();
+        return n;
+    }
 
-        if (m_size <= 0) {
-            m_mutex.unlock();
-            return false;
+    // 不等待，取出当前所有元素追加到 items，返回取出的个数
+    int pop_all(std::vector<T>& items) {
+        m_mutex.lock();
+        int n = m_size;
+        for (int i = 0; i < n; ++i) {
+            m_front = (m_front + 1) % m_max_size;
+            items.push_back(std::move(m_array[m_front]));
         }
+        m_size = 0;
+        m_mutex.unlock();
+        return n;
+    }
 
-        m_front = (m_front + 1) % m_max_size;
-        item = m_array[m_front];
-        m_size--;
+   private:
+    // 放入 count 个元素后调用，调用方持有锁：队列由空变为非空时唤醒一个等待的消费者
+    void notify_push(int count) {
+        bool was_empty = 0 == m_size;
+        m_size += count;
+        if (was_empty && count > 0 && m_waiters > 0) {
+            m_cond.signal();
+        }
+    }
 
-        m_mutex.unlock();
-        return true;
+    // 从队首移出 count 个元素，调用方持有锁；还有剩余且有消费者在等时唤醒下一个
+    void take(T* items, int count) {
+        for (int i = 0; i < count; ++i) {
+            m_front = (m_front + 1) % m_max_size;
+            items[i] = std::move(m_array[m_front]);
+        }
+        m_size -= count;
+        if (m_size > 0 && m_waiters > 0) {
+            m_cond.signal();
+        }
     }
 
    private:
@@ -192,6 +260,7 @@ class block_queue {
     int m_max_size;
     int m_front;
     int m_back;
+    int m_waiters;  // 在条件变量上等待的消费者数
 };
 
 #endif  // !BLOCK_QUEUE_H_
\ No newline at end of file
@@ -0,0 +1,290 @@
+// 阻塞队列与异步日志的吞吐：block_queue_bench [每个生产者的条数]
+//
+// queue 一项：8、16、32 个生产者向容量 800 的队列放入约 100 字节的日志行，一个消费者取出。
+//   old    原先的 block_queue：先 full() 再 push()，每次放入都 broadcast，元素复制进出
+//   single 现在的 try_push / pop，元素移动进出，只在队列由空变为非空时 signal
+//   batch  生产者每次 push_batch 16 条，消费者 pop_batch 一次取出全部
+// 队列满时生产者让出 CPU 后重试，统计每秒从队列取出的条数。
+// logger 一项：同样的生产者数通过 LOG_INFO 写异步日志，统计到 flush() 写完为止每秒写出的行数，
+//   以及实际写入文件的比例。wait 为默认设置，后台线程跟不上时生产者等待缓冲区归还；drop 对应 -k 1，
+//   info 日志改为丢弃，写入比例可能低于 100%。
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "block_queue.h"
+#include "log.h"
+
+// 原先的 block_queue，只保留用到的操作
+template <class T>
+class old_block_queue {
+   public:
+    explicit old_block_queue(int max_size) : m_size(0), m_max_size(max_size), m_front(-1), m_back(-1) {
+        m_array = new T[max_size];
+    }
+    ~old_block_queue() { delete[] m_array; }
+
+    bool full() {
+        m_mutex.lock();
+        bool ret = m_size >= m_max_size;
+        m_mutex.unlock();
+        return ret;
+    }
+
+    bool push(const T& item) {
+        m_mutex.lock();
+        if (m_size >= m_max_size) {
+            m_cond.broadcast();
+            m_mutex.unlock();
+            return false;
+        }
+        m_back = (m_back + 1) % m_max_size;
+        m_array[m_back] = item;
+        m_size++;
+        m_cond.broadcast();
+        m_mutex.unlock();
+        return true;
+    }
+
+    bool pop(T& item) {
+        m_mutex.lock();
+        while (m_size <= 0) {
+            if (!m_cond.wait(m_mutex.get())) {
+                m_mutex.unlock();
+                return false;
+            }
+        }
+        m_front = (m_front + 1) % m_max_size;
+        item = m_array[m_front];
+        m_size--;
+        m_mutex.unlock();
+        return true;
+    }
+
+   private:
+    locker m_mutex;
+    cond m_cond;
+    T* m_array;
+    int m_size;
+    int m_max_size;
+    int m_front;
+    int m_back;
+};
+
+enum bench_mode { MODE_OLD, MODE_SINGLE, MODE_BATCH };
+
+static const int QUEUE_SIZE = 800;  // 与服务器异步日志的队列长度相同
+static const int PUSH_BATCH = 16;
+
+struct bench_ctx {
+    bench_mode mode;
+    long items;  // 每个生产者的条数
+    old_block_queue<std::string>* old_queue;
+    block_queue<std::string>* queue;
+};
+
+static std::string make_line(long i) {
+    char buf[128];
+    int n = snprintf(buf, sizeof(buf), "2026-10-16 12:00:00.%06ld [info]: send data to the client(192.168.1.%ld)",
+                     i % 1000000, i % 256);
+    return std::string(buf, n);
+}
+
+static void* producer(void* arg) {
+    bench_ctx* ctx = (bench_ctx*)arg;
+    std::string batch[PUSH_BATCH];
+    for (long i = 0; i < ctx->items;) {
+        if (MODE_OLD == ctx->mode) {
+            std::string line = make_line(i);
+            // 原先 write_log 的写法：两次加锁
+            if (!ctx->old_queue->full() && ctx->old_queue->push(line)) {
+                ++i;
+            } else {
+                sched_yield();
+            }
+        } else if (MODE_SINGLE == ctx->mode) {
+            std::string line = make_line(i);
+            while (!ctx->queue->try_push(std::move(line))) {
+                sched_yield();
+            }
+            ++i;
+        } else {
+            int count = 0;
+            for (; count < PUSH_BATCH && i + count < ctx->items; ++count) {
+                batch[count] = make_line(i + count);
+            }
+            int pushed = 0;
+            while (pushed < count) {
+                int n = ctx->queue->push_batch(batch + pushed, count - pushed);
+                if (n == 0) {
+                    sched_yield();
+                }
+                pushed += n;
+            }
+            i += count;
+        }
+    }
+    return NULL;
+}
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 防止编译器把结果当作无用而优化掉
+static volatile size_t g_sink;
+
+// 返回每秒取出的条数（百万）
+static double run_queue(bench_mode mode, int producers, long items) {
+    old_block_queue<std::string> old_queue(QUEUE_SIZE);
+    block_queue<std::string> queue(QUEUE_SIZE);
+    bench_ctx ctx = {mode, items, &old_queue, &queue};
+    std::vector<pthread_t> threads(producers);
+
+    double start = now_sec();
+    for (int i = 0; i < producers; ++i) {
+        pthread_create(&threads[i], NULL, producer, &ctx);
+    }
+
+    long total = items * producers;
+    size_t bytes = 0;
+    std::vector<std::string> out(QUEUE_SIZE);
+    for (long got = 0; got < total;) {
+        if (MODE_OLD == mode) {
+            old_queue.pop(out[0]);
+            bytes += out[0].size();
+            ++got;
+        } else if (MODE_SINGLE == mode) {
+            queue.pop(out[0]);
+            bytes += out[0].size();
+            ++got;
+        } else {
+            int n = queue.pop_batch(out.data(), QUEUE_SIZE, 100);
+            for (int i = 0; i < n; ++i) {
+                bytes += out[i].size();
+            }
+            got += n;
+        }
+    }
+    double t = now_sec() - start;
+    for (int i = 0; i < producers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    g_sink = bytes;
+    return total / t / 1e6;
+}
+
+struct logger_ctx {
+    long items;
+};
+
+static void* log_producer(void* arg) {
+    logger_ctx* ctx = (logger_ctx*)arg;
+    int m_close_log = 0;  // LOG_* 宏读取的开关
+    for (long i = 0; i < ctx->items; ++i) {
+        LOG_INFO("send data to the client(192.168.1.%ld)", i % 256);
+    }
+    return NULL;
+}
+
+// 当前日志文件中的行数，从 offset 处开始统计
+static long count_lines(const std::string& path, off_t& offset) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    long lines = 0;
+    char buf[65536];
+    ssize_t n;
+    while ((n = pread(fd, buf, sizeof(buf), offset)) > 0) {
+        for (ssize_t i = 0; i < n; ++i) {
+            lines += buf[i] == '\n';
+        }
+        offset += n;
+    }
+    close(fd);
+    return lines;
+}
+
+// 返回每秒写出的行数（百万）与实际写入文件的比例
+static double run_logger(int producers, long items, const std::string& path, off_t& offset, double& written) {
+    logger_ctx ctx = {items};
+    std::vector<pthread_t> threads(producers);
+    double start = now_sec();
+    for (int i = 0; i < producers; ++i) {
+        pthread_create(&threads[i], NULL, log_producer, &ctx);
+    }
+    for (int i = 0; i < producers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    Log::get_instance()->flush();
+    double t = now_sec() - start;
+    long lines = count_lines(path, offset);
+    written = (double)lines / (items * producers);
+    return items * producers / t / 1e6;
+}
+
+int main(int argc, char* argv[]) {
+    long items = argc > 1 ? atol(argv[1]) : 200000;
+    if (items <= 0) {
+        fprintf(stderr, "usage: %s [items]\n", argv[0]);
+        return 1;
+    }
+
+    const int counts[] = {8, 16, 32};
+    printf("%-10s %10s %10s %10s\n", "producers", "old M/s", "single M/s", "batch M/s");
+    for (int producers : counts) {
+        double o = run_queue(MODE_OLD, producers, items);
+        double s = run_queue(MODE_SINGLE, producers, items);
+        double b = run_queue(MODE_BATCH, producers, items);
+        printf("%-10d %10.2f %10.2f %10.2f\n", producers, o, s, b);
+    }
+
+    // 与服务器相同的参数：单行最长 2000 字节，队列长度 800
+    char dir[] = "/tmp/block_queue_benchXXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string name = std::string(dir) + "/ServerLog";
+    if (!Log::get_instance()->init(name.c_str(), 0, 2000, 0x7fffffff, 800)) {
+        fprintf(stderr, "log init failed\n");
+        return 1;
+    }
+    Log::get_instance()->set_level(1);
+
+    // init 在文件名前加上日期，目录中只有这一个文件
+    std::string path;
+    DIR* d = opendir(dir);
+    while (struct dirent* ent = readdir(d)) {
+        if (ent->d_name[0] != '.') {
+            path = std::string(dir) + "/" + ent->d_name;
+        }
+    }
+    closedir(d);
+
+    printf("\nasync logger, file in %s\n", dir);
+    printf("%-10s %-6s %12s %10s\n", "producers", "mode", "lines M/s", "written");
+    off_t offset = 0;
+    for (int producers : counts) {
+        for (int drop = 0; drop < 2; ++drop) {
+            Log::get_instance()->set_drop(drop != 0);
+            double written;
+            double rate = run_logger(producers, items, path, offset, written);
+            printf("%-10d %-6s %12.2f %9.1f%%\n", producers, drop ? "drop" : "wait", rate, written * 100);
+        }
+    }
+    return 0;
+}
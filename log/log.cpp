@@ -1,147 +1,700 @@
 #include "log.h"
 
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <pthread.h>
 #include <stdarg.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <vector>
 using namespace std;
 
-Log::Log() {
+Log::Log(int slot) {
+    m_slot = slot;
+    m_level = 0;
     m_count = 0;
+    m_bytes = 0;
+    m_segment = 0;
+    m_max_bytes = 0;
+    m_gzip = false;
+    m_keep = 0;
+    m_keep_bytes = 0;
+    m_rotating = false;
+    m_rotate_new_day = false;
     m_is_async = false;
+    m_binary = false;
+    m_format_count = 0;
+    m_formats_written = 0;
+    m_dropped_format = MAX_FORMATS;
+    m_fd = -1;
+    m_log_queue = NULL;
+    m_threads = NULL;
+    m_dropped = 0;
+    m_drop = false;
+    m_stop = false;
+    m_close_log = 1;
 }
 
 Log::~Log() {
-    if (m_fp != NULL) {
-        fclose(m_fp);
+    // 先让后台线程和维护线程结束，再由本线程写出剩余的日志；尚未完成的切换和压缩放弃
+    m_stop = true;
+    if (m_is_async) {
+        m_log_queue->push(NULL);
+        m_stopped.wait();
+    }
+    if (m_fd >= 0) {
+        m_rotate.post();
+        m_maintain_stopped.wait();
+        flush();
+        close(m_fd);
     }
 }
 
-// 异步需要设置阻塞队列的长度，同步不需要设置
-bool Log::init(const char* file_name, int close_log, int log_buf_size, int split_lines, int max_queue_size) {
-    // 如果设置了 max_queue_size，则设置为异步
-    if (max_queue_size >= 1) {
-        m_is_async = true;
-        m_log_queue = new block_queue<string>(max_queue_size);
-        pthread_t tid;
-        // flush_log_thread 为回调函数，这里表示创建线程异步写日志
-        pthread_create(&tid, NULL, flush_log_thread, NULL);
+void Log::set_rotation(const char* policy) {
+    // 与 Cache-Control 配置相同，以 ';' 分隔
+    const char* p = policy;
+    while (p && *p) {
+        const char* end = strchr(p, ';');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        std::string item(p, len);
+        size_t eq = item.find('=');
+        std::string key = item.substr(0, eq);
+        long long value = eq == std::string::npos ? 1 : atoll(item.c_str() + eq + 1);
+        if ("size" == key) {
+            m_max_bytes = value << 20;
+        } else if ("gzip" == key) {
+            m_gzip = value != 0;
+        } else if ("keep" == key) {
+            m_keep = value;
+        } else if ("total" == key) {
+            m_keep_bytes = value << 20;
+        }
+        p = end ? end + 1 : NULL;
     }
+}
 
+// 异步需要设置阻塞队列的长度，同步不需要设置
+bool Log::init(const char* file_name, int close_log, int log_buf_size, int split_lines, int max_queue_size,
+               bool binary) {
     m_close_log = close_log;
-    m_log_buf_size = log_buf_size;
-    m_buf = new char[m_log_buf_size];
-    memset(m_buf, '\0', m_log_buf_size);
+    // 单行日志连同时间戳必须能放进一块线程缓冲区
+    m_log_buf_size = log_buf_size < 128 ? 128 : log_buf_size;
+    if (m_log_buf_size > log_buffer::SIZE / 2) {
+        m_log_buf_size = log_buffer::SIZE / 2;
+    }
     m_split_lines = split_lines;
 
     time_t t = time(NULL);
-    struct tm* sys_tm = localtime(&t);
-    struct tm my_tm = *sys_tm;
+    struct tm my_tm;
+    localtime_r(&t, &my_tm);
 
     const char* p = strrchr(file_name, '/');
-    char log_full_name[256] = {0};
+    // 目录与文件名之外留出日期部分的空间
+    char log_full_name[sizeof(dir_name) + sizeof(log_name) + 48] = {0};
 
+    // 切换文件时也用到目录与文件名，不带目录时目录为空
     if (p == NULL) {
-        snprintf(log_full_name, 255, "%d_%02d_%02d_%s", my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday,
-                 file_name);
+        dir_name[0] = '\0';
+        snprintf(log_name, sizeof(log_name), "%s", file_name);
     } else {
-        strcpy(log_name, p + 1);
-        strncpy(dir_name, file_name, p - file_name + 1);
-        snprintf(log_full_name, 255, "%s%d_%02d_%02d_%s", dir_name, my_tm.tm_year + 1900, my_tm.tm_mon + 1,
-                 my_tm.tm_mday, log_name);
+        snprintf(dir_name, sizeof(dir_name), "%.*s", (int)(p - file_name + 1), file_name);
+        snprintf(log_name, sizeof(log_name), "%s", p + 1);
     }
+    snprintf(log_full_name, sizeof(log_full_name), "%s%d_%02d_%02d_%s", dir_name, my_tm.tm_year + 1900, my_tm.tm_mon + 1,
+             my_tm.tm_mday, log_name);
 
     m_today = my_tm.tm_mday;
 
-    m_fp = fopen(log_full_name, "a");
-    if (m_fp == NULL) {
+    // 当天的文件已被切分压缩时从下一个空闲序号开始，否则它再被压缩时会覆盖已有的 .gz
+    std::string path = log_full_name;
+    struct stat st;
+    if (stat((path + ".gz").c_str(), &st) == 0) {
+        path = next_path(false);
+    }
+    m_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
         return false;
     }
+    m_path = path;
+    // 同一天重启时接着写已有的文件，按大小切分要算上已有的内容
+    if (fstat(m_fd, &st) == 0) {
+        m_bytes = st.st_size;
+    }
+
+    // 如果设置了 max_queue_size，则设置为异步
+    if (max_queue_size >= 1) {
+        m_is_async = true;
+        m_binary = binary;
+        if (m_binary) {
+            m_dropped_format = register_format(2, "%llu log lines dropped", __FILE__, __LINE__);
+            m_bytes += start_file(m_fd);
+        }
+        m_log_queue = new block_queue<log_buffer*>(max_queue_size);
+        pthread_t tid;
+        // flush_log_thread 为回调函数，这里表示创建线程异步写日志
+        pthread_create(&tid, NULL, flush_log_thread, this);
+        pthread_detach(tid);
+    }
+
+    // 打开新文件、压缩与清理由维护线程完成
+    pthread_t tid;
+    pthread_create(&tid, NULL, maintain_thread, this);
+    pthread_detach(tid);
 
     return true;
 }
 
+thread_log* Log::local() {
+    static thread_local thread_log* t_logs[MAX_LOGS] = {NULL};
+    thread_log*& t_log = t_logs[m_slot];
+    if (!t_log) {
+        t_log = new thread_log();
+        // 无锁插入注册链表，只增不删：本服务器的线程不会退出，退出的线程留下的日志也会被写出
+        thread_log* head = m_threads.load(std::memory_order_relaxed);
+        do {
+            t_log->next = head;
+        } while (!m_threads.compare_exchange_weak(head, t_log, std::memory_order_release, std::memory_order_relaxed));
+    }
+    return t_log;
+}
+
+uint32_t Log::register_format(int level, const char* format, const char* file, int line) {
+    m_format_mutex.lock();
+    uint32_t id = m_format_count.load(std::memory_order_relaxed);
+    if (id < MAX_FORMATS) {
+        m_formats[id].init(level, format, file, line);
+        // 后台线程先读到使用该格式的日志再读计数，release 保证它能看到完整的登记内容
+        m_format_count.store(id + 1, std::memory_order_release);
+    }
+    m_format_mutex.unlock();
+    return id;
+}
+
+char* Log::reserve(thread_log* tl, log_buffer*& buf, uint32_t& start, int level) {
+    // 同步模式把本线程的第一块缓冲区当作格式化空间
+    buf = &tl->bufs[tl->current];
+    start = 0;
+    if (!m_is_async) {
+        return buf->data;
+    }
+    start = buf->len.load(std::memory_order_relaxed);
+    if (log_buffer::SIZE - start < (uint32_t)m_log_buf_size + 64) {
+        // 开启丢弃时只丢 debug、info 与访问日志（level 小于 0），warn 与 error 总是等待
+        bool droppable = m_drop && level < 2;
+        log_buffer* other = &tl->bufs[tl->current ^ 1];
+        // 另一块还在后台线程手中，说明写文件跟不上；它已在队列中，后台线程写完就会归还
+        while (other->busy.load(std::memory_order_acquire)) {
+            if (droppable || m_stop) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return NULL;
+            }
+            usleep(WAIT_US);
+        }
+        buf->busy.store(true, std::memory_order_release);
+        while (!m_log_queue->try_push(buf)) {
+            if (droppable || m_stop) {
+                // 丢弃时这一块留给后台线程按时间写出后再归还
+                buf->busy.store(false, std::memory_order_release);
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return NULL;
+            }
+            usleep(WAIT_US);
+        }
+        tl->current ^= 1;
+        buf = other;
+        start = 0;
+    }
+    return buf->data + start;
+}
+
 void Log::write_log(int level, const char* format, ...) {
+    va_list valst;
+    va_start(valst, format);
+    write_line(level, format, valst);
+    va_end(valst);
+}
+
+void Log::write_plain(const char* format, ...) {
+    va_list valst;
+    va_start(valst, format);
+    write_line(-1, format, valst);
+    va_end(valst);
+}
+
+void Log::write_line(int level, const char* format, va_list valst) {
+    if (m_fd < 0) {
+        return;
+    }
+    thread_log* tl = local();
+    log_buffer* buf;
+    uint32_t start;
+    char* p = reserve(tl, buf, start, level);
+    if (!p) {
+        return;
+    }
+
     struct timeval now = {0, 0};
     gettimeofday(&now, NULL);
-    time_t t = now.tv_sec;
-    struct tm* sys_tm = localtime(&t);
-    struct tm my_tm = *sys_tm;
-
-    char s[16] = {0};
-    switch (level) {
-        case 0:
-            strcpy(s, "[debug]:");
-            break;
-        case 1:
-            strcpy(s, "[info]:");
-            break;
-        case 2:
-            strcpy(s, "[warn]:");
-            break;
-        case 3:
-            strcpy(s, "[error]:");
-            break;
-        default:
-            strcpy(s, "[info]:");
-            break;
+    if (now.tv_sec != tl->sec) {
+        struct tm my_tm;
+        localtime_r(&now.tv_sec, &my_tm);
+        // 各字段按取值范围取模，编译器可以确认格式化结果不超过 stamp 的长度
+        snprintf(tl->stamp, sizeof(tl->stamp), "%04u-%02u-%02u %02u:%02u:%02u", (my_tm.tm_year + 1900) % 10000u,
+                 (my_tm.tm_mon + 1) % 100u, my_tm.tm_mday % 100u, my_tm.tm_hour % 100u, my_tm.tm_min % 100u,
+                 my_tm.tm_sec % 100u);
+        tl->sec = now.tv_sec;
+        tl->mday = my_tm.tm_mday;
+    }
+
+    // 写入的具体时间内容格式：2026-01-01 12:00:00.000000 [info]: ...
+    int n = 0;
+    if (level >= 0) {
+        const char* s = log_level_name(level);
+        size_t stamp_len = strlen(tl->stamp);
+        memcpy(p, tl->stamp, stamp_len);
+        n = stamp_len;
+        p[n++] = '.';
+        for (int i = 5, usec = now.tv_usec; i >= 0; --i, usec /= 10) {
+            p[n + i] = '0' + usec % 10;
+        }
+        n += 6;
+        p[n++] = ' ';
+        size_t level_len = strlen(s);
+        memcpy(p + n, s, level_len);
+        n += level_len;
+        p[n++] = ' ';
+    }
+
+    int m = vsnprintf(p + n, m_log_buf_size - n - 1, format, valst);
+    // vsnprintf 返回的是完整输出需要的长度，超长的行被截断
+    if (m < 0) {
+        m = 0;
+    } else if (m > m_log_buf_size - n - 2) {
+        m = m_log_buf_size - n - 2;
+    }
+    p[n + m] = '\n';
+    uint32_t len = n + m + 1;
+
+    if (m_is_async) {
+        // 整行写完后再发布，后台线程只会看到完整的行
+        buf->len.store(start + len, std::memory_order_release);
+        return;
     }
 
-    // 写入一个 log，对 m_count++，m_split_line 最大行数
     m_mutex.lock();
-    m_count++;
+    rotate(1, len, tl->mday);
+    if (write(m_fd, p, len) < 0) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_mutex.unlock();
+}
+
+void Log::rotate(int lines, size_t bytes, int mday) {
+    m_count += lines;
+    m_bytes += bytes;
+    if (m_rotating) {
+        return;
+    }
+    bool new_day = m_today != mday;
+    bool split = (m_split_lines > 0 && m_count >= m_split_lines) || (m_max_bytes > 0 && m_bytes >= m_max_bytes);
+    if (!new_day && !split) {
+        return;
+    }
+    m_today = mday;
+    m_rotate_new_day = new_day;
+    m_rotating = true;
+    m_rotate.post();
+}
+
+void Log::maintain() {
+    // 压缩与清理不和请求线程争抢 CPU
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
 
-    if (m_today != my_tm.tm_mday || m_count % m_split_lines == 0) {  // everyday log
-        char new_log[256] = {0};
-        fflush(m_fp);
-        fclose(m_fp);
-        char tail[16] = {0};
+    while (true) {
+        m_rotate.wait();
+        if (m_stop) {
+            break;
+        }
+        m_mutex.lock();
+        bool new_day = m_rotate_new_day;
+        m_mutex.unlock();
 
-        snprintf(tail, 16, "%d_%02d_%02d_", my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday);
+        // 在锁外打开新文件，二进制模式先写好开始记录
+        std::string path = next_path(new_day);
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        long long bytes = 0;
+        if (fd >= 0) {
+            struct stat st;
+            if (fstat(fd, &st) == 0) {
+                bytes = st.st_size;
+            }
+            if (m_binary) {
+                bytes += start_file(fd);
+            }
+        }
 
-        if (m_today != my_tm.tm_mday) {
-            snprintf(new_log, 255, "%s%s%s", dir_name, tail, log_name);
-            m_today = my_tm.tm_mday;
-            m_count = 0;
+        // 锁内只替换描述符：同步模式的写入线程与后台线程要么写完旧文件，要么开始写新文件
+        m_mutex.lock();
+        int old_fd = -1;
+        std::string old_path;
+        if (fd >= 0) {
+            old_fd = m_fd;
+            old_path = m_path;
+            m_fd = fd;
+            m_path = path;
+            m_bytes = bytes;
+            m_formats_written = 0;
         } else {
-            snprintf(new_log, 255, "%s%s%s.%lld", dir_name, tail, log_name, m_count / m_split_lines);
+            // 打开失败时仍写旧文件，再写满一个文件的量后重试
+            m_bytes = 0;
+        }
+        m_count = 0;
+        m_rotating = false;
+        m_mutex.unlock();
+
+        if (old_fd < 0) {
+            continue;
+        }
+        close(old_fd);
+        if (m_gzip) {
+            compress(old_path);
         }
-        m_fp = fopen(new_log, "a");
+        retain();
     }
+    m_maintain_stopped.post();
+}
 
-    m_mutex.unlock();
+std::string Log::next_path(bool new_day) {
+    time_t t = time(NULL);
+    struct tm my_tm;
+    localtime_r(&t, &my_tm);
+    char base[sizeof(dir_name) + sizeof(log_name) + 48] = {0};
+    snprintf(base, sizeof(base), "%s%d_%02d_%02d_%s", dir_name, my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday,
+             log_name);
+    if (new_day) {
+        m_segment = 0;
+        return base;
+    }
 
-    va_list valst;
-    va_start(valst, format);
+    // 跳过已存在的序号（包括已压缩的），重启后不会追加到旧的切分文件或覆盖它的压缩文件
+    std::string path;
+    struct stat st;
+    do {
+        path = std::string(base) + "." + std::to_string(++m_segment);
+    } while (stat(path.c_str(), &st) == 0 || stat((path + ".gz").c_str(), &st) == 0);
+    return path;
+}
 
-    string log_str;
-    m_mutex.lock();
+bool Log::compress(const std::string& path) {
+    int in = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return false;
+    }
+    // 先写临时文件，完整写完再改名，不会留下截断的 .gz
+    std::string gz = path + ".gz";
+    std::string tmp = gz + ".tmp";
+    gzFile out = gzopen(tmp.c_str(), "wb6");
+    if (!out) {
+        close(in);
+        return false;
+    }
+
+    std::vector<char> buf(64 * 1024);
+    bool ok = true;
+    while (true) {
+        // 退出时放弃压缩，保留原文件
+        if (m_stop) {
+            ok = false;
+            break;
+        }
+        ssize_t n = read(in, buf.data(), buf.size());
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            ok = 0 == n;
+            break;
+        }
+        if (gzwrite(out, buf.data(), n) != n) {
+            ok = false;
+            break;
+        }
+    }
+    close(in);
+    if (gzclose(out) != Z_OK) {
+        ok = false;
+    }
+    if (!ok || rename(tmp.c_str(), gz.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    unlink(path.c_str());
+    return true;
+}
+
+bool Log::is_segment(const char* name) {
+    // 日期部分：YYYY_MM_DD_
+    static const char pattern[] = "dddd_dd_dd_";
+    for (int i = 0; i < 11; ++i) {
+        if ('d' == pattern[i] ? (name[i] < '0' || name[i] > '9') : name[i] != pattern[i]) {
+            return false;
+        }
+    }
+    size_t len = strlen(log_name);
+    if (strncmp(name + 11, log_name, len) != 0) {
+        return false;
+    }
+    const char* rest = name + 11 + len;
+    if ('.' == rest[0] && rest[1] >= '0' && rest[1] <= '9') {
+        ++rest;
+        while (*rest >= '0' && *rest <= '9') {
+            ++rest;
+        }
+    }
+    return '\0' == rest[0] || strcmp(rest, ".gz") == 0;
+}
 
-    // 写入的具体时间内容格式
-    int n = snprintf(m_buf, 48, "%d-%02d-%02d %02d:%02d:%02d.%06ld %s ", my_tm.tm_year + 1900, my_tm.tm_mon + 1,
-                     my_tm.tm_mday, my_tm.tm_hour, my_tm.tm_min, my_tm.tm_sec, now.tv_usec, s);
-    int m = vsnprintf(m_buf + n, m_log_buf_size - n - 1, format, valst);
-    m_buf[n + m] = '\n';
-    m_buf[n + m + 1] = '\0';
-    log_str = m_buf;
+void Log::retain() {
+    if (0 == m_keep && 0 == m_keep_bytes) {
+        return;
+    }
+    DIR* dir = opendir(dir_name[0] ? dir_name : ".");
+    if (!dir) {
+        return;
+    }
 
-    m_mutex.unlock();
+    struct segment {
+        std::string path;
+        struct timespec mtime;
+        long long size;
+    };
+    std::vector<segment> segments;
+    long long total = 0;
+    while (struct dirent* ent = readdir(dir)) {
+        if (!is_segment(ent->d_name)) {
+            continue;
+        }
+        std::string path = std::string(dir_name) + ent->d_name;
+        struct stat st;
+        // 正在写的文件不计入
+        if (path == m_path || stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        segments.push_back({path, st.st_mtim, (long long)st.st_size});
+        total += st.st_size;
+    }
+    closedir(dir);
+
+    // 从最旧的开始删除，直到文件数与总大小都不超过限制
+    std::sort(segments.begin(), segments.end(), [](const segment& a, const segment& b) {
+        return a.mtime.tv_sec != b.mtime.tv_sec ? a.mtime.tv_sec < b.mtime.tv_sec : a.mtime.tv_nsec < b.mtime.tv_nsec;
+    });
+    size_t count = segments.size();
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if ((0 == m_keep || count <= (size_t)m_keep) && (0 == m_keep_bytes || total <= m_keep_bytes)) {
+            break;
+        }
+        if (unlink(segments[i].path.c_str()) == 0) {
+            --count;
+            total -= segments[i].size;
+        }
+    }
+}
+
+size_t Log::start_file(int fd) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    log_record_header h;
+    h.id = LOG_RECORD_START;
+    h.len = sizeof(h);
+    h.ns = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+    if (write(fd, &h, sizeof(h)) < 0) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+    return sizeof(h);
+}
+
+void Log::append_formats(std::string& out) {
+    uint32_t count = m_format_count.load(std::memory_order_acquire);
+    for (; m_formats_written < count; ++m_formats_written) {
+        const log_format& f = m_formats[m_formats_written];
+        size_t file_len = strlen(f.file) + 1;
+        size_t format_len = strlen(f.format) + 1;
+        log_record_header h;
+        h.id = LOG_RECORD_FORMAT;
+        h.len = sizeof(h) + 12 + file_len + format_len;
+        h.ns = 0;
+        uint32_t fields[3] = {m_formats_written, (uint32_t)f.level, (uint32_t)f.line};
+        out.append((const char*)&h, sizeof(h));
+        out.append((const char*)fields, sizeof(fields));
+        out.append(f.file, file_len);
+        out.append(f.format, format_len);
+    }
+}
+
+void Log::async_write_log() {
+    log_buffer* full[MAX_BATCH];
+    while (!m_stop) {
+        // 等待写满的缓冲区，一次取出一批；超时后照样收集各线程未写满的部分
+        int count = m_log_queue->pop_batch(full, MAX_BATCH, FLUSH_INTERVAL_MS);
 
-    if (m_is_async && !m_log_queue->full()) {
-        m_log_queue->push(log_str);
-    } else {
         m_mutex.lock();
-        fputs(log_str.c_str(), m_fp);
+        drain(full, count);
         m_mutex.unlock();
     }
+    m_stopped.post();
+}
 
-    va_end(valst);
+void Log::drain(log_buffer** full, int full_count) {
+    std::vector<struct iovec> iov;
+    iov.reserve(full_count + 16);
+    std::vector<std::pair<log_buffer*, uint32_t>> partial;
+
+    // 先写交上来的缓冲区，它们的内容早于所属线程当前缓冲区中的内容；NULL 只用于唤醒后台线程
+    for (int i = 0; i < full_count; ++i) {
+        log_buffer* b = full[i];
+        if (!b) {
+            continue;
+        }
+        b->in_batch = true;
+        uint32_t len = b->len.load(std::memory_order_acquire);
+        if (len > b->flushed) {
+            iov.push_back({b->data + b->flushed, len - b->flushed});
+        }
+    }
+
+    // 再写各线程未写满的缓冲区中已发布的部分；线程有缓冲区已交出但还在队列里时本轮跳过它，保持行的先后顺序
+    for (thread_log* tl = m_threads.load(std::memory_order_acquire); tl; tl = tl->next) {
+        bool pending = false;
+        for (int i = 0; i < 2; ++i) {
+            log_buffer* b = &tl->bufs[i];
+            if (b->busy.load(std::memory_order_acquire) && !b->in_batch) {
+                pending = true;
+            }
+        }
+        if (pending) {
+            continue;
+        }
+        for (int i = 0; i < 2; ++i) {
+            log_buffer* b = &tl->bufs[i];
+            if (b->in_batch || b->busy.load(std::memory_order_acquire)) {
+                continue;
+            }
+            uint32_t len = b->len.load(std::memory_order_acquire);
+            if (len > b->flushed) {
+                iov.push_back({b->data + b->flushed, len - b->flushed});
+                partial.push_back(std::make_pair(b, len));
+            }
+        }
+    }
+
+    uint64_t dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+    char note[64];
+    if (dropped > 0) {
+        int n;
+        if (m_binary) {
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            log_encoder enc(note, sizeof(note), m_formats[m_dropped_format]);
+            enc.put((unsigned long long)dropped);
+            n = enc.finish(m_dropped_format, (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec);
+        } else {
+            n = snprintf(note, sizeof(note), "[warn]: %llu log lines dropped\n", (unsigned long long)dropped);
+        }
+        iov.push_back({note, (size_t)n});
+    }
+
+    std::string formats;
+    if (!iov.empty()) {
+        // 按行数与大小切分文件：文本日志数换行符，二进制日志数记录，各段都由完整的记录组成
+        int lines = 0;
+        size_t bytes = 0;
+        for (size_t i = 0; i < iov.size(); ++i) {
+            const char* p = (const char*)iov[i].iov_base;
+            const char* end = p + iov[i].iov_len;
+            bytes += iov[i].iov_len;
+            if (m_binary) {
+                for (log_record_header h; p < end; p += h.len, ++lines) {
+                    memcpy(&h, p, sizeof(h));
+                }
+                continue;
+            }
+            while ((p = (const char*)memchr(p, '\n', end - p)) != NULL) {
+                ++lines;
+                ++p;
+            }
+        }
+        time_t t = time(NULL);
+        struct tm my_tm;
+        localtime_r(&t, &my_tm);
+        rotate(lines, bytes, my_tm.tm_mday);
+
+        // 本轮日志用到的格式都已登记：计数在读取各缓冲区长度之后读取
+        if (m_binary) {
+            append_formats(formats);
+            if (!formats.empty()) {
+                iov.insert(iov.begin(), {(void*)formats.data(), formats.size()});
+            }
+        }
+
+        // writev 一次最多 IOV_MAX 段，部分写入时从中断处继续
+        size_t idx = 0;
+        while (idx < iov.size()) {
+            int cnt = iov.size() - idx < (size_t)IOV_MAX ? iov.size() - idx : IOV_MAX;
+            ssize_t ret = writev(m_fd, &iov[idx], cnt);
+            if (ret < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            while (idx < iov.size() && (size_t)ret >= iov[idx].iov_len) {
+                ret -= iov[idx].iov_len;
+                ++idx;
+            }
+            if (idx < iov.size()) {
+                iov[idx].iov_base = (char*)iov[idx].iov_base + ret;
+                iov[idx].iov_len -= ret;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < partial.size(); ++i) {
+        partial[i].first->flushed = partial[i].second;
+    }
+    // 写完的缓冲区清空后归还给所属线程
+    for (int i = 0; i < full_count; ++i) {
+        log_buffer* b = full[i];
+        if (!b) {
+            continue;
+        }
+        b->in_batch = false;
+        b->flushed = 0;
+        b->len.store(0, std::memory_order_relaxed);
+        b->busy.store(false, std::memory_order_release);
+    }
 }
 
 void Log::flush(void) {
+    if (!m_is_async) {
+        return;
+    }
+    // 退出前调用：把已交出的缓冲区和各线程未写满的部分都写出
+    log_buffer* full[MAX_BATCH];
     m_mutex.lock();
-    // 强制刷新写入流缓冲区
-    fflush(m_fp);
+    int count = m_log_queue->pop_batch(full, MAX_BATCH, 0);
+    drain(full, count);
     m_mutex.unlock();
-}
\ No newline at end of file
+}
@@ -3,82 +3,271 @@
 
 #include <pthread.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 
+#include <atomic>
 #include <iostream>
 #include <string>
 
 #include "block_queue.h"
+#include "log_binary.h"
 
 using namespace std;
 
+/**
+ * @brief 每个线程自己的日志缓冲区
+ *
+ * 生产线程只向自己的 current 追加格式化好的日志行，len 以 release 发布，整行对后台线程可见后才计入。
+ * 写满时把它标记为 busy 交给后台线程，换用另一块继续写（双缓冲）；后台线程写完后清空并清除 busy 归还。
+ * 后台线程还会按时间把未写满的缓冲区中已发布的部分写出，flushed 只由后台线程修改
+ */
+struct log_buffer {
+    static const int SIZE = 64 * 1024;
+
+    char data[SIZE];
+    std::atomic<uint32_t> len;   // 已发布的字节数，生产线程修改，后台线程归还时清零
+    std::atomic<bool> busy;      // 已交给后台线程
+    uint32_t flushed;            // 已写入文件的字节数，只由后台线程访问
+    bool in_batch;               // 本轮已从队列取出，只由后台线程访问
+
+    log_buffer() : len(0), busy(false), flushed(0), in_batch(false) {}
+};
+
+struct thread_log {
+    log_buffer bufs[2];
+    int current;               // 正在写的缓冲区下标，只由所属线程访问
+    thread_log* next;          // 注册链表，线程首次写日志时无锁插入表头
+
+    // 当前秒的时间戳前缀缓存，同一秒内不再调用 localtime_r
+    time_t sec;
+    char stamp[24];
+    int mday;
+
+    thread_log() : current(0), next(NULL), sec(-1), mday(0) {}
+};
+
 class Log {
    public:
     // C++11 以后，使用局部变量懒汉不用加载
     static Log* get_instance() {
-        static Log instance;
+        static Log instance(0);
+        return &instance;
+    }
+
+    /** @brief 访问日志，与运行日志分开写入另一个文件 */
+    static Log* get_access() {
+        static Log instance(1);
         return &instance;
     }
 
-    static void* flush_log_thread(void* args) { Log::get_instance()->async_write_log(); }
+    static void* flush_log_thread(void* args) {
+        ((Log*)args)->async_write_log();
+        return NULL;
+    }
+
+    static void* maintain_thread(void* args) {
+        ((Log*)args)->maintain();
+        return NULL;
+    }
 
-    // 可选择的参数有日志文件、日志缓冲区大小、最大行数以及最长日志条队列
+    /**
+     * @brief 设置切分、压缩与保留策略，须在 init 之前调用
+     *
+     * 形如 "size=64;gzip;keep=30;total=1024"：size 为单个文件的最大 MB 数；gzip 表示压缩切分出的文件；
+     * keep 与 total 为最多保留的已切分文件数与它们的总 MB 数。不写或为 0 表示不限
+     */
+    void set_rotation(const char* policy);
+
+    // 可选择的参数有日志文件、单行日志最大长度、最大行数以及最长日志条队列，binary 只在异步模式下有效
     bool init(const char* file_name, int close_log, int log_buf_size = 8192, int split_lines = 5000000,
-              int max_queue_size = 0);
+              int max_queue_size = 0, bool binary = false);
 
     void write_log(int level, const char* format, ...);
 
+    /** @brief 写一行不带时间和级别前缀的日志，行内容自带时间（访问日志） */
+    void write_plain(const char* format, ...);
+
+    /** @brief 运行时的最低级别，低于它的 LOG_* 不求值参数 */
+    int level() const { return m_level; }
+    void set_level(int level) { m_level = level; }
+
+    /**
+     * @brief 后台线程跟不上时是否丢弃 debug 与 info 日志，默认不丢弃
+     *
+     * 不丢弃时写日志的线程等待后台线程归还缓冲区；warn 与 error 无论如何都不丢弃
+     */
+    void set_drop(bool drop) { m_drop = drop; }
+
+    /** @brief 是否写二进制日志，由 LOG_* 宏选择 write_binary 还是 write_log */
+    bool binary() const { return m_binary; }
+
+    /**
+     * @brief 登记一条格式，返回格式 ID
+     *
+     * 由 LOG_* 宏在每个调用点首次执行时调用一次，format 与 file 须为静态存储的字符串
+     */
+    uint32_t register_format(int level, const char* format, const char* file, int line);
+
+    /**
+     * @brief 写一条二进制日志：只把格式 ID、时间戳和参数原样复制进本线程缓冲区，格式化由 logdecode 离线完成
+     */
+    template <typename... Args>
+    void write_binary(uint32_t id, const Args&... args) {
+        if (m_fd < 0 || id >= MAX_FORMATS) {
+            return;
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        log_buffer* buf;
+        uint32_t start;
+        char* p = reserve(local(), buf, start, m_formats[id].level);
+        if (!p) {
+            return;
+        }
+        log_encoder enc(p, m_log_buf_size, m_formats[id]);
+        (enc.put(args), ...);
+        uint32_t len = enc.finish(id, (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec);
+        buf->len.store(start + len, std::memory_order_release);
+    }
+
+    /** @brief 把所有线程已发布的日志立即写入文件，退出前调用；平时由后台线程按时间和缓冲区写满驱动 */
     void flush(void);
 
    private:
-    Log();
+    explicit Log(int slot);
     virtual ~Log();
 
-    void* async_write_log() {
-        string single_log;
+    /** @brief 格式化一行并交给后台线程或直接写出，level 小于 0 时不加时间和级别前缀（访问日志） */
+    void write_line(int level, const char* format, va_list valst);
 
-        // 从阻塞队列中取出一个日志 string，写入文件
-        while (m_log_queue->pop(single_log)) {
-            m_mutex.lock();
-            fputs(single_log.c_str(), m_fp);
-            m_mutex.unlock();
-        }
-    }
+    /** @brief 后台线程：等待写满的缓冲区或刷新间隔到期，收集各线程的日志后一次 writev 写出 */
+    void async_write_log();
+
+    /** @brief 收集一轮日志并写出，调用方持有 m_mutex */
+    void drain(log_buffer** full, int full_count);
+
+    /** @brief 取得本线程的缓冲区，首次调用时创建并注册 */
+    thread_log* local();
+
+    /**
+     * @brief 在本线程缓冲区中留出一条日志的空间
+     *
+     * 异步模式下剩余空间放不下最长的一行时把当前缓冲区交给后台线程并换用另一块。
+     * 另一块尚未归还或队列已满时等待后台线程；开启 m_drop 时 debug、info 与访问日志的行改为丢弃
+     * @return 写入位置；丢弃本行或进程正在退出时返回 NULL
+     */
+    char* reserve(thread_log* tl, log_buffer*& buf, uint32_t& start, int level);
+
+    /** @brief 二进制模式下在新文件开头写入开始记录，返回写入的字节数；切换到该文件后需要重新登记所有格式 */
+    size_t start_file(int fd);
+
+    /** @brief 把还没写入当前文件的格式登记记录追加到 out */
+    void append_formats(std::string& out);
+
+    /**
+     * @brief 记录即将写入的行数与字节数，需要按天、行数或大小切换文件时通知维护线程，调用方持有 m_mutex
+     *
+     * 切换完成之前的日志仍写入当前文件，请求线程和后台线程不等待打开新文件
+     */
+    void rotate(int lines, size_t bytes, int mday);
+
+    /** @brief 维护线程：打开新文件后在锁内替换描述符，再压缩切分出的文件并按保留策略删除旧文件 */
+    void maintain();
+
+    /** @brief 生成下一个文件的路径：新的一天为当天的文件，否则为当天未被占用的下一个序号 */
+    std::string next_path(bool new_day);
+
+    /** @brief 把 path 压缩为 path.gz 后删除原文件 */
+    bool compress(const std::string& path);
+
+    /** @brief 文件名是否为本日志切分出的文件：<日期>_<log_name>[.序号][.gz] */
+    bool is_segment(const char* name);
+
+    /** @brief 按保留策略从最旧的开始删除已切分的文件 */
+    void retain();
 
    private:
-    char dir_name[128];  // 路径名
-    char log_name[128];  // log 文件名
-    int m_split_lines;   // 日志最大行数
-    int m_log_buf_size;  // 日志缓冲区大小
-    long long m_count;   // 日志行数记录
-    int m_today;         // 因为按天分类，记录当前时间是哪一天
-    FILE* m_fp;          // 打开 log 的文件指针
-    char* m_buf;
-    block_queue<string>* m_log_queue;  // 阻塞队列
-    bool m_is_async;                   // 是否同步标志位
-    locker m_mutex;
+    static const int FLUSH_INTERVAL_MS = 1000;  // 未写满的缓冲区最长滞留时间
+    static const int MAX_BATCH = 256;           // 一轮最多处理的写满缓冲区数
+    static const uint32_t MAX_FORMATS = 1024;   // 二进制模式最多登记的格式数
+    static const int MAX_LOGS = 2;              // 日志实例数：运行日志与访问日志
+    static const int WAIT_US = 100;             // 等待后台线程归还缓冲区时每次休眠的微秒数
+
+    int m_slot;             // 实例序号，区分各实例的线程缓冲区
+    int m_level;            // 运行时的最低级别
+    char dir_name[128];     // 路径名
+    char log_name[128];     // log 文件名
+    int m_split_lines;      // 日志最大行数
+    int m_log_buf_size;     // 单行日志最大长度
+    long long m_count;      // 当前文件的行数
+    long long m_bytes;      // 当前文件的字节数
+    int m_today;            // 因为按天分类，记录当前时间是哪一天
+    std::atomic<int> m_fd;  // 日志文件描述符，写入线程不加锁读取它判断是否已初始化
+    std::string m_path;     // 当前文件的路径，只由 init 与维护线程修改
+    int m_segment;          // 当天最近一个切分文件的序号
+
+    long long m_max_bytes;   // 单个文件的最大字节数，0 为不按大小切分
+    bool m_gzip;             // 是否压缩切分出的文件
+    int m_keep;              // 最多保留的已切分文件数，0 为不限
+    long long m_keep_bytes;  // 已切分文件的最大总字节数，0 为不限
+    bool m_rotating;         // 已通知维护线程切换文件，尚未完成
+    bool m_rotate_new_day;   // 本次切换是否因为日期变化
+    sem m_rotate;            // 通知维护线程切换文件
+    sem m_maintain_stopped;  // 维护线程已结束
+    block_queue<log_buffer*>* m_log_queue;  // 写满的缓冲区，交给后台线程
+    bool m_is_async;                        // 是否异步写入
+    bool m_binary;                          // 是否写二进制日志
+    locker m_mutex;                         // 串行写文件（同步模式的写入线程、后台线程与 flush()）与替换描述符
+    std::atomic<thread_log*> m_threads;     // 所有写过日志的线程
+    std::atomic<uint64_t> m_dropped;        // 后台线程跟不上时丢弃的行数
+    bool m_drop;                            // 后台线程跟不上时丢弃 debug 与 info 日志，而不是等待
+    std::atomic<bool> m_stop;               // 进程退出，后台线程结束
+    sem m_stopped;                          // 后台线程已结束
+    log_format m_formats[MAX_FORMATS];      // 二进制模式登记的格式，下标即格式 ID
+    std::atomic<uint32_t> m_format_count;   // 已登记的格式数，以 release 发布
+    uint32_t m_formats_written;             // 已写入当前文件的格式数，只在 m_mutex 内访问
+    uint32_t m_dropped_format;              // 丢弃统计所用的格式
+    locker m_format_mutex;                  // 串行登记格式
     int m_close_log;  // 关闭日志
 };
 
-#define LOG_DEBUG(format, ...)                                    \
-    if (0 == m_close_log) {                                       \
-        Log::get_instance()->write_log(0, format, ##__VA_ARGS__); \
-        Log::get_instance()->flush();                             \
-    }
-#define LOG_INFO(format, ...)                                     \
-    if (0 == m_close_log) {                                       \
-        Log::get_instance()->write_log(1, format, ##__VA_ARGS__); \
-        Log::get_instance()->flush();                             \
-    }
-#define LOG_WARN(format, ...)                                     \
-    if (0 == m_close_log) {                                       \
-        Log::get_instance()->write_log(2, format, ##__VA_ARGS__); \
-        Log::get_instance()->flush();                             \
-    }
-#define LOG_ERROR(format, ...)                                    \
-    if (0 == m_close_log) {                                       \
-        Log::get_instance()->write_log(3, format, ##__VA_ARGS__); \
-        Log::get_instance()->flush();                             \
+// 编译期的最低级别，低于它的 LOG_* 展开为空，make LOG_LEVEL=1 去掉所有 LOG_DEBUG
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+// 运行时的级别在求值参数之前判断；二进制模式下每个调用点的格式在首次执行时登记，此后只复制参数
+#define LOG_WRITE(lvl, format, ...)                                                                       \
+    if (0 == m_close_log && (lvl) >= Log::get_instance()->level()) {                                      \
+        Log* log_instance = Log::get_instance();                                                          \
+        if (log_instance->binary()) {                                                                     \
+            static const uint32_t log_format_id =                                                         \
+                log_instance->register_format(lvl, format, __FILE__, __LINE__);                           \
+            log_instance->write_binary(log_format_id, ##__VA_ARGS__);                                     \
+        } else {                                                                                          \
+            log_instance->write_log(lvl, format, ##__VA_ARGS__);                                          \
+        }                                                                                                 \
     }
 
-#endif  // !LOG_H
\ No newline at end of file
+#if LOG_MIN_LEVEL <= 0
+#define LOG_DEBUG(format, ...) LOG_WRITE(0, format, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(format, ...) \
+    {}
+#endif
+#if LOG_MIN_LEVEL <= 1
+#define LOG_INFO(format, ...) LOG_WRITE(1, format, ##__VA_ARGS__)
+#else
+#define LOG_INFO(format, ...) \
+    {}
+#endif
+#if LOG_MIN_LEVEL <= 2
+#define LOG_WARN(format, ...) LOG_WRITE(2, format, ##__VA_ARGS__)
+#else
+#define LOG_WARN(format, ...) \
+    {}
+#endif
+#define LOG_ERROR(format, ...) LOG_WRITE(3, format, ##__VA_ARGS__)
+
+#endif  // !LOG_H
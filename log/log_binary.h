@@ -0,0 +1,219 @@
+#ifndef LOG_BINARY_H
+#define LOG_BINARY_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/**
+ * 二进制日志的记录格式，日志模块与 logdecode 共用
+ *
+ * 文件由连续的记录组成，每条记录以 log_record_header 开头，len 为含头部在内的总字节数：
+ * > * LOG_RECORD_START：一次运行或一个新文件的开始，之前登记的格式全部作废
+ * > * LOG_RECORD_FORMAT：登记一条格式，内容为 uint32 格式 ID、uint32 级别、uint32 行号、'\0' 结尾的源文件名和格式串
+ * > * 其它：一条日志，id 为格式 ID，ns 为 CLOCK_REALTIME 纳秒，随后是按调用顺序排列的参数
+ *
+ * 参数以一个字节的类型开头：'i' 为 8 字节整数，'f' 为 8 字节 double，'p' 为 8 字节指针值，
+ * 's' 为 uint32 长度加不含 '\0' 的字节。所有字段按本机字节序存放，不对齐
+ */
+static const uint32_t LOG_RECORD_START = 0xfffffffe;
+static const uint32_t LOG_RECORD_FORMAT = 0xffffffff;
+
+/** @brief 日志级别在文本日志中的写法 */
+inline const char* log_level_name(int level) {
+    static const char* levels[] = {"[debug]:", "[info]:", "[warn]:", "[error]:"};
+    return level >= 0 && level <= 3 ? levels[level] : levels[1];
+}
+
+struct log_record_header {
+    uint32_t id;
+    uint32_t len;
+    uint64_t ns;
+};
+
+/** @brief 格式串中的一个转换说明 */
+struct log_spec {
+    const char* begin;  // 指向 '%'
+    const char* end;    // 转换字符之后
+    char conv;          // 转换字符，格式串在说明中途结束时为 '\0'
+    char length;        // 长度修饰：'\0'、'h'、'H'（hh）、'l'、'L'（ll 或 L）、'j'、'z'、't'
+    bool star_width;    // 宽度取自参数
+    bool star_prec;     // 精度取自参数
+    int prec;           // 格式串中写明的精度，没有为 -1
+};
+
+/**
+ * @brief 从 p 开始找下一个转换说明，跳过 "%%"
+ *
+ * @return 找到返回 true，spec 描述该说明；格式串结束返回 false
+ */
+inline bool parse_log_spec(const char* p, log_spec& spec) {
+    while ((p = strchr(p, '%')) != NULL) {
+        if ('%' == p[1]) {
+            p += 2;
+            continue;
+        }
+        spec.begin = p++;
+        while (*p && strchr("-+ #0", *p)) {
+            ++p;
+        }
+        spec.star_width = '*' == *p;
+        if (spec.star_width) {
+            ++p;
+        }
+        while (*p >= '0' && *p <= '9') {
+            ++p;
+        }
+        spec.star_prec = false;
+        spec.prec = -1;
+        if ('.' == *p) {
+            ++p;
+            spec.prec = 0;
+            if ('*' == *p) {
+                spec.star_prec = true;
+                spec.prec = -1;
+                ++p;
+            }
+            while (*p >= '0' && *p <= '9') {
+                spec.prec = spec.prec * 10 + (*p++ - '0');
+            }
+        }
+        spec.length = '\0';
+        if ('h' == *p || 'l' == *p) {
+            spec.length = *p++;
+            if (spec.length == *p) {
+                spec.length = 'h' == spec.length ? 'H' : 'L';
+                ++p;
+            }
+        } else if (*p && strchr("Ljzt", *p)) {
+            spec.length = *p++;
+        }
+        spec.conv = *p;
+        spec.end = *p ? p + 1 : p;
+        return true;
+    }
+    return false;
+}
+
+/** @brief 一条登记过的格式 */
+struct log_format {
+    int level;
+    const char* format;
+    const char* file;
+    int line;
+    // 按参数下标记录字符串参数的长度上限：-1 读到 '\0'，-2 取前一个参数（%.*s），其它为格式串中写明的精度
+    std::vector<int> limits;
+
+    void init(int lvl, const char* fmt, const char* f, int l) {
+        level = lvl;
+        format = fmt;
+        file = f;
+        line = l;
+        limits.clear();
+        log_spec spec;
+        for (const char* p = fmt; parse_log_spec(p, spec); p = spec.end) {
+            if (spec.star_width) {
+                limits.push_back(-1);
+            }
+            if (spec.star_prec) {
+                limits.push_back(-1);
+            }
+            limits.push_back(spec.star_prec ? -2 : spec.prec);
+            if (!spec.conv) {
+                break;
+            }
+        }
+    }
+};
+
+/**
+ * @brief 把一条日志的参数原样写入缓冲区，不做格式化
+ *
+ * 空间不够时截断字符串，放不下的定长参数连同之后的参数一起丢弃，解码时缺少的参数输出为空
+ */
+class log_encoder {
+   public:
+    log_encoder(char* buf, size_t cap, const log_format& fmt)
+        : m_begin(buf), m_p(buf + sizeof(log_record_header)), m_end(buf + cap), m_fmt(fmt), m_arg(0), m_last(0) {}
+
+    template <typename T>
+    void put(const T& v) {
+        if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+            // 无符号数按位保存，解码时按格式串的转换字符解释
+            m_last = (int64_t)v;
+            put_fixed('i', &m_last);
+        } else if constexpr (std::is_floating_point_v<T>) {
+            double d = v;
+            put_fixed('f', &d);
+        } else if constexpr (std::is_convertible_v<const T&, const char*>) {
+            const char* s = v;
+            put_string(s ? s : "(null)", s ? (size_t)-1 : 6);
+        } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            std::string_view s = v;
+            put_string(s.data(), s.size());
+        } else if constexpr (std::is_pointer_v<T>) {
+            uint64_t addr = (uint64_t)(uintptr_t)v;
+            put_fixed('p', &addr);
+        } else {
+            static_assert(std::is_pointer_v<T>, "unsupported log argument type");
+        }
+        ++m_arg;
+    }
+
+    /** @brief 填写记录头部，返回记录的总字节数 */
+    uint32_t finish(uint32_t id, uint64_t ns) {
+        log_record_header h;
+        h.id = id;
+        h.len = m_p - m_begin;
+        h.ns = ns;
+        memcpy(m_begin, &h, sizeof(h));
+        return h.len;
+    }
+
+   private:
+    void put_fixed(char type, const void* v) {
+        if (m_end - m_p < 9) {
+            m_end = m_p;
+            return;
+        }
+        *m_p = type;
+        memcpy(m_p + 1, v, 8);
+        m_p += 9;
+    }
+
+    // size 为 -1 时字符串以 '\0' 结尾
+    void put_string(const char* s, size_t size) {
+        if (m_end - m_p < 5) {
+            m_end = m_p;
+            return;
+        }
+        size_t max = m_end - m_p - 5;
+        int limit = m_arg < m_fmt.limits.size() ? m_fmt.limits[m_arg] : -1;
+        if (-2 == limit) {
+            // %.*s 的字符串不一定以 '\0' 结尾，只读精度以内的部分
+            limit = m_last < 0 ? -1 : (m_last > (int64_t)max ? (int)max : (int)m_last);
+        }
+        if (limit >= 0 && (size_t)limit < max) {
+            max = limit;
+        }
+        uint32_t len = (size_t)-1 == size ? strnlen(s, max) : (size < max ? size : max);
+        *m_p = 's';
+        memcpy(m_p + 1, &len, 4);
+        memcpy(m_p + 5, s, len);
+        m_p += 5 + len;
+    }
+
+   private:
+    char* m_begin;
+    char* m_p;
+    char* m_end;
+    const log_format& m_fmt;
+    size_t m_arg;
+    int64_t m_last;  // 最近一个整数参数，作为 %.*s 的精度
+};
+
+#endif  // !LOG_BINARY_H
@@ -0,0 +1,276 @@
+// 把二进制日志还原为文本日志的格式：logdecode [文件...]，不带参数时读标准输入，结果写到标准输出
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "log_binary.h"
+
+struct decoded_format {
+    int level;
+    std::string format;
+};
+
+// 一个参数
+struct log_arg {
+    char type;
+    uint64_t value;
+    const char* str;
+    uint32_t len;
+};
+
+// 按参数的转换说明格式化一个参数，追加到 out
+static void format_arg(std::string& out, const log_spec& spec, const int* stars, int star_count, const log_arg& arg) {
+    char fmt[64];
+    size_t n = spec.end - spec.begin;
+    if (n >= sizeof(fmt) - 4) {
+        return;
+    }
+    char buf[512];
+    int len = -1;
+    if ('s' == spec.conv) {
+        // 字符串按记录中的长度输出，原有的精度已在写入时生效
+        size_t pos = 0;
+        for (const char* p = spec.begin; p < spec.end && *p != '.' && *p != 's'; ++p) {
+            fmt[pos++] = *p;
+        }
+        memcpy(fmt + pos, ".*s", 4);
+        const char* s = 's' == arg.type ? arg.str : "";
+        int slen = 's' == arg.type ? arg.len : 0;
+        // 没有宽度和标志的字符串直接追加，长字符串不经过 buf
+        if (1 == pos) {
+            out.append(s, slen);
+            return;
+        }
+        if (spec.star_width) {
+            len = snprintf(buf, sizeof(buf), fmt, stars[0], slen, s);
+        } else {
+            len = snprintf(buf, sizeof(buf), fmt, slen, s);
+        }
+    } else {
+        memcpy(fmt, spec.begin, n);
+        fmt[n] = '\0';
+        int w = star_count > 0 ? stars[0] : 0;
+        int pr = star_count > 1 ? stars[1] : 0;
+#define FORMAT_WITH(value)                                                   \
+    do {                                                                     \
+        if (2 == star_count) {                                               \
+            len = snprintf(buf, sizeof(buf), fmt, w, pr, value);             \
+        } else if (1 == star_count) {                                        \
+            len = snprintf(buf, sizeof(buf), fmt, w, value);                 \
+        } else {                                                             \
+            len = snprintf(buf, sizeof(buf), fmt, value);                    \
+        }                                                                    \
+    } while (0)
+        bool wide = 'l' == spec.length || 'L' == spec.length || 'j' == spec.length || 'z' == spec.length ||
+                    't' == spec.length;
+        switch (spec.conv) {
+            case 'd':
+            case 'i':
+                if (wide) {
+                    FORMAT_WITH((long long)arg.value);
+                } else {
+                    FORMAT_WITH((int)arg.value);
+                }
+                break;
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                if (wide) {
+                    FORMAT_WITH((unsigned long long)arg.value);
+                } else {
+                    FORMAT_WITH((unsigned)arg.value);
+                }
+                break;
+            case 'c':
+                FORMAT_WITH((int)arg.value);
+                break;
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A': {
+                double d = 0;
+                if ('f' == arg.type) {
+                    memcpy(&d, &arg.value, sizeof(d));
+                } else {
+                    d = (double)(long long)arg.value;
+                }
+                if ('L' == spec.length) {
+                    FORMAT_WITH((long double)d);
+                } else {
+                    FORMAT_WITH(d);
+                }
+                break;
+            }
+            case 'p':
+                FORMAT_WITH((void*)(uintptr_t)arg.value);
+                break;
+            default:
+                break;
+        }
+#undef FORMAT_WITH
+    }
+    if (len > 0) {
+        out.append(buf, len < (int)sizeof(buf) ? len : sizeof(buf) - 1);
+    }
+}
+
+// 按格式串还原一条日志的正文
+static void format_message(std::string& out, const char* format, const std::vector<log_arg>& args) {
+    static const log_arg missing = {'\0', 0, NULL, 0};
+    size_t next = 0;
+    const char* p = format;
+    log_spec spec;
+    while (parse_log_spec(p, spec)) {
+        for (const char* q = p; q < spec.begin; ++q) {
+            out.push_back(*q);
+            if ('%' == *q) {
+                ++q;  // "%%"
+            }
+        }
+        int stars[2] = {0, 0};
+        int star_count = 0;
+        if (spec.star_width) {
+            stars[star_count++] = next < args.size() ? (int)args[next++].value : 0;
+        }
+        if (spec.star_prec) {
+            // 精度已在写入字符串时生效，数值转换仍需要
+            stars[star_count++] = next < args.size() ? (int)args[next++].value : 0;
+        }
+        if (!spec.conv) {
+            return;
+        }
+        if ('n' != spec.conv) {
+            const log_arg& arg = next < args.size() ? args[next++] : missing;
+            format_arg(out, spec, stars, 's' == spec.conv ? (spec.star_width ? 1 : 0) : star_count, arg);
+        }
+        p = spec.end;
+    }
+    for (const char* q = p; *q; ++q) {
+        out.push_back(*q);
+        if ('%' == *q && '%' == q[1]) {
+            ++q;
+        }
+    }
+}
+
+static bool decode(FILE* in, FILE* out) {
+    std::unordered_map<uint32_t, decoded_format> formats;
+    std::vector<char> rec;
+    std::vector<log_arg> args;
+    std::string line;
+    time_t last_sec = -1;
+    char stamp[80] = {0};
+
+    log_record_header h;
+    while (fread(&h, sizeof(h), 1, in) == 1) {
+        if (h.len < sizeof(h)) {
+            fprintf(stderr, "logdecode: corrupt record\n");
+            return false;
+        }
+        rec.resize(h.len - sizeof(h));
+        if (!rec.empty() && fread(rec.data(), rec.size(), 1, in) != 1) {
+            fprintf(stderr, "logdecode: truncated record\n");
+            return false;
+        }
+        const char* p = rec.data();
+        const char* end = p + rec.size();
+
+        if (LOG_RECORD_START == h.id) {
+            formats.clear();
+            continue;
+        }
+        if (LOG_RECORD_FORMAT == h.id) {
+            uint32_t fields[3];
+            if (rec.size() < sizeof(fields)) {
+                continue;
+            }
+            memcpy(fields, p, sizeof(fields));
+            const char* file = p + sizeof(fields);
+            const char* file_end = (const char*)memchr(file, '\0', end - file);
+            if (!file_end) {
+                continue;
+            }
+            const char* format = file_end + 1;
+            if (!memchr(format, '\0', end - format)) {
+                continue;
+            }
+            decoded_format& f = formats[fields[0]];
+            f.level = fields[1];
+            f.format = format;
+            continue;
+        }
+
+        auto it = formats.find(h.id);
+        if (it == formats.end()) {
+            fprintf(stderr, "logdecode: unknown format %u\n", h.id);
+            continue;
+        }
+
+        args.clear();
+        while (p < end) {
+            log_arg arg = {*p, 0, NULL, 0};
+            if ('s' == arg.type && end - p >= 5) {
+                memcpy(&arg.len, p + 1, 4);
+                if ((size_t)(end - p - 5) < arg.len) {
+                    break;
+                }
+                arg.str = p + 5;
+                p += 5 + arg.len;
+            } else if (end - p >= 9) {
+                memcpy(&arg.value, p + 1, 8);
+                p += 9;
+            } else {
+                break;
+            }
+            args.push_back(arg);
+        }
+
+        // 与文本日志相同：2026-01-01 12:00:00.000000 [info]: ...
+        time_t sec = h.ns / 1000000000;
+        if (sec != last_sec) {
+            struct tm my_tm;
+            localtime_r(&sec, &my_tm);
+            snprintf(stamp, sizeof(stamp), "%d-%02d-%02d %02d:%02d:%02d", my_tm.tm_year + 1900, my_tm.tm_mon + 1,
+                     my_tm.tm_mday, my_tm.tm_hour, my_tm.tm_min, my_tm.tm_sec);
+            last_sec = sec;
+        }
+        char head[64];
+        int n = snprintf(head, sizeof(head), "%s.%06u %s ", stamp, (unsigned)(h.ns % 1000000000 / 1000),
+                         log_level_name(it->second.level));
+        line.assign(head, n);
+        format_message(line, it->second.format.c_str(), args);
+        line.push_back('\n');
+        fwrite(line.data(), 1, line.size(), out);
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        return decode(stdin, stdout) ? 0 : 1;
+    }
+    int ret = 0;
+    for (int i = 1; i < argc; ++i) {
+        FILE* in = fopen(argv[i], "rb");
+        if (!in) {
+            perror(argv[i]);
+            ret = 1;
+            continue;
+        }
+        if (!decode(in, stdout)) {
+            ret = 1;
+        }
+        fclose(in);
+    }
+    return ret;
+}
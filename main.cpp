@@ -14,7 +14,11 @@ int main(int argc, char* argv[]) {
 
     // 初始化
     server.init(config.PORT, user, passwd, databaseName, config.LOGWrite, config.OPT_LINGER, config.TRIGMode,
-                config.sql_num, config.thread_num, config.close_log, config.actor_model);
+                config.sql_num, config.thread_num, config.close_log, config.actor_model, config.reactor_num,
+                config.dispatch_mode, config.reuseport, config.backlog,
+                config.io_backend, config.steal, config.zerocopy, config.cache_size,
+                config.cache_control, config.log_level, config.access_sample,
+                config.log_rotate, config.log_drop);
 
     // 日志
     server.log_write();
@@ -0,0 +1,164 @@
+#ifndef BUFFER_CHAIN_H
+#define BUFFER_CHAIN_H
+
+#include <string.h>
+
+#include "buffer_pool.h"
+
+/**
+ * @brief 由定长块组成的读缓冲链
+ *
+ * 块从共享的 buffer_pool 中按需取出，读到的数据依次追加到链尾，请求越大占用的块越多；
+ * 连接空闲时整条链归还给池，不再为每个连接常驻一块最大尺寸的读缓冲区。
+ * 每块最后保留 1 字节，解析时可以在数据末尾写入 '\0'。
+ *
+ * 块内有效数据为 [begin, end)，只有被 carry_over 搬走了开头一部分数据的块 begin 才不为 0。
+ */
+class buffer_chain {
+   public:
+    /** @brief 单条链最多的块数，限制单个请求占用的内存 */
+    static const int MAX_BLOCKS = 16;
+
+    struct block {
+        char* data;
+        int begin;
+        int end;
+    };
+
+    explicit buffer_chain(buffer_pool* pool) : m_pool(pool), m_count(0) {}
+    ~buffer_chain() { clear(); }
+
+    /** @brief 每块可存放的数据字节数 */
+    int capacity() const { return (int)m_pool->block_size() - 1; }
+
+    /** @brief 整条链最多可存放的数据字节数 */
+    long max_size() const { return (long)capacity() * MAX_BLOCKS; }
+
+    int count() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+    block& at(int i) { return m_blocks[i]; }
+    bool full(int i) const { return m_blocks[i].end == capacity(); }
+
+    /**
+     * @brief 取得链尾的可写空间，链尾块已满时再取一块
+     *
+     * @param len 输出可写字节数
+     * @return 可写位置，链已达到 MAX_BLOCKS 时返回 NULL
+     */
+    char* write_space(int& len) {
+        if (m_count == 0 || full(m_count - 1)) {
+            if (m_count >= MAX_BLOCKS) {
+                len = 0;
+                return NULL;
+            }
+            block& b = m_blocks[m_count++];
+            b.data = m_pool->acquire();
+            b.begin = b.end = 0;
+        }
+        block& tail = m_blocks[m_count - 1];
+        len = capacity() - tail.end;
+        return tail.data + tail.end;
+    }
+
+    /** @brief 确认写入了 len 字节 */
+    void commit(int len) { m_blocks[m_count - 1].end += len; }
+
+    /** @brief 追加一段数据，链已满时返回 false */
+    bool append(const char* data, int len) {
+        while (len > 0) {
+            int space;
+            char* dst = write_space(space);
+            if (!dst) {
+                return false;
+            }
+            int n = len < space ? len : space;
+            memcpy(dst, data, n);
+            commit(n);
+            data += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    /** @brief 从第 i 块的 off 处起（含）到链尾的字节数 */
+    long size_from(int i, int off) const {
+        long total = m_blocks[i].end - off;
+        for (int j = i + 1; j < m_count; j++) {
+            total += m_blocks[j].end - m_blocks[j].begin;
+        }
+        return total;
+    }
+
+    /**
+     * @brief 把第 i 块 from 之后的数据挪到紧随其后的新块开头，再从下一块搬来数据补满
+     *
+     * 用于保证一行不跨块：第 i 块中已解析的部分原地不动，指向它的指针仍然有效
+     *
+     * @return 池中取不到块或链已满时返回 false
+     */
+    bool carry_over(int i, int from) {
+        if (m_count >= MAX_BLOCKS) {
+            return false;
+        }
+        char* data = m_pool->acquire();
+        int len = m_blocks[i].end - from;
+        memcpy(data, m_blocks[i].data + from, len);
+        m_blocks[i].end = from;
+
+        memmove(&m_blocks[i + 2], &m_blocks[i + 1], (m_count - i - 1) * sizeof(block));
+        m_blocks[i + 1].data = data;
+        m_blocks[i + 1].begin = 0;
+        m_blocks[i + 1].end = len;
+        m_count++;
+
+        if (i + 2 < m_count) {
+            block& next = m_blocks[i + 2];
+            int n = next.end - next.begin;
+            if (n > capacity() - len) {
+                n = capacity() - len;
+            }
+            memcpy(data + len, next.data + next.begin, n);
+            m_blocks[i + 1].end += n;
+            next.begin += n;
+            if (next.begin == next.end) {
+                remove(i + 2);
+            }
+        }
+        return true;
+    }
+
+    /** @brief 丢弃第 i 块 off 之前的所有数据，数据全部丢弃的块归还给池 */
+    void consume(int i, int off) {
+        for (int j = 0; j < i; j++) {
+            m_pool->release(m_blocks[j].data);
+        }
+        memmove(&m_blocks[0], &m_blocks[i], (m_count - i) * sizeof(block));
+        m_count -= i;
+        m_blocks[0].begin = off;
+        if (m_blocks[0].begin == m_blocks[0].end) {
+            remove(0);
+        }
+    }
+
+    /** @brief 归还所有块 */
+    void clear() {
+        for (int i = 0; i < m_count; i++) {
+            m_pool->release(m_blocks[i].data);
+        }
+        m_count = 0;
+    }
+
+   private:
+    void remove(int i) {
+        m_pool->release(m_blocks[i].data);
+        memmove(&m_blocks[i], &m_blocks[i + 1], (m_count - i - 1) * sizeof(block));
+        m_count--;
+    }
+
+   private:
+    buffer_pool* m_pool;
+    block m_blocks[MAX_BLOCKS];
+    int m_count;
+};
+
+#endif  // !BUFFER_CHAIN_H
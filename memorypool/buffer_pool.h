@@ -0,0 +1,69 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+
+#include <exception>
+#include <vector>
+
+#include "../lock/locker.h"
+
+/**
+ * @brief 定长缓冲区池
+ *
+ * 缓冲区按块（chunk）向系统申请，每块切分为若干个定长缓冲区挂到空闲链表上；
+ * 连接建立时 acquire，关闭时 release，占用的内存随同时在线的连接数增长，而不是按最大描述符数预先分配。
+ */
+class buffer_pool {
+   public:
+    /**
+     * @param block_size       单个缓冲区的字节数
+     * @param blocks_per_chunk 每次向系统申请时切分出的缓冲区个数
+     */
+    buffer_pool(size_t block_size, int blocks_per_chunk = 64)
+        : m_block_size(block_size), m_blocks_per_chunk(blocks_per_chunk) {
+        if (block_size == 0 || blocks_per_chunk <= 0) {
+            throw std::exception();
+        }
+    }
+
+    ~buffer_pool() {
+        for (size_t i = 0; i < m_chunks.size(); i++) {
+            delete[] m_chunks[i];
+        }
+    }
+
+    /** @brief 取出一个空闲缓冲区，空闲链表为空时再申请一块 */
+    char* acquire() {
+        m_locker.lock();
+        if (m_free.empty()) {
+            char* chunk = new char[m_block_size * m_blocks_per_chunk];
+            m_chunks.push_back(chunk);
+            for (int i = m_blocks_per_chunk - 1; i >= 0; i--) {
+                m_free.push_back(chunk + i * m_block_size);
+            }
+        }
+        char* block = m_free.back();
+        m_free.pop_back();
+        m_locker.unlock();
+        return block;
+    }
+
+    /** @brief 归还缓冲区，后归还的先被取出，尽量复用仍在缓存中的内存 */
+    void release(char* block) {
+        m_locker.lock();
+        m_free.push_back(block);
+        m_locker.unlock();
+    }
+
+    size_t block_size() const { return m_block_size; }
+
+   private:
+    size_t m_block_size;
+    int m_blocks_per_chunk;
+    locker m_locker;
+    std::vector<char*> m_free;    // 空闲缓冲区
+    std::vector<char*> m_chunks;  // 已申请的内存块，析构时统一释放
+};
+
+#endif  // !BUFFER_POOL_H
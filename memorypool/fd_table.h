@@ -0,0 +1,68 @@
+#ifndef FD_TABLE_H
+#define FD_TABLE_H
+
+#include <atomic>
+#include <exception>
+
+#include "../lock/locker.h"
+
+/**
+ * @brief 以文件描述符为下标、按页惰性分配的对象表
+ *
+ * 对象按页（slab）成批创建，某一页只有在其范围内的描述符第一次被访问时才分配。
+ * 内核总是分配最小的可用描述符，因此实际分配的页数跟随连接数的峰值，而不是 MAX_FD。
+ * 对象一旦创建便与描述符绑定、地址不变，描述符复用时复用同一个对象。
+ */
+template <typename T>
+class fd_table {
+   public:
+    explicit fd_table(int max_fd) {
+        if (max_fd <= 0) {
+            throw std::exception();
+        }
+        m_page_num = (max_fd + PAGE_SIZE - 1) >> PAGE_SHIFT;
+        m_pages = new std::atomic<T*>[m_page_num];
+        for (int i = 0; i < m_page_num; i++) {
+            m_pages[i].store(NULL, std::memory_order_relaxed);
+        }
+    }
+
+    ~fd_table() {
+        for (int i = 0; i < m_page_num; i++) {
+            delete[] m_pages[i].load(std::memory_order_relaxed);
+        }
+        delete[] m_pages;
+    }
+
+    /** @brief 取描述符对应的对象，所在页尚未分配时先分配 */
+    T& operator[](int fd) {
+        T* page = m_pages[fd >> PAGE_SHIFT].load(std::memory_order_acquire);
+        if (!page) {
+            page = alloc_page(fd >> PAGE_SHIFT);
+        }
+        return page[fd & (PAGE_SIZE - 1)];
+    }
+
+   private:
+    // 多个 reactor 线程可能同时访问同一个未分配的页，加锁后再检查一次
+    T* alloc_page(int index) {
+        m_locker.lock();
+        T* page = m_pages[index].load(std::memory_order_relaxed);
+        if (!page) {
+            page = new T[PAGE_SIZE]();
+            m_pages[index].store(page, std::memory_order_release);
+        }
+        m_locker.unlock();
+        return page;
+    }
+
+   private:
+    static const int PAGE_SHIFT = 8;
+    static const int PAGE_SIZE = 1 << PAGE_SHIFT;  // 每页 256 个对象
+
+    int m_page_num;
+    std::atomic<T*>* m_pages;
+    locker m_locker;
+};
+
+#endif  // !FD_TABLE_H
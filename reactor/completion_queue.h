@@ -0,0 +1,63 @@
+#ifndef COMPLETION_QUEUE_H
+#define COMPLETION_QUEUE_H
+
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <exception>
+#include <vector>
+
+#include "../lock/locker.h"
+
+/**
+ * @brief 工作线程向 reactor 回报任务完成的通知队列
+ *
+ * 工作线程 post 已处理完的连接，只有队列由空变为非空时才写 eventfd 唤醒 reactor；
+ * reactor 在 eventfd 可读时 drain 一次取走全部结果，事件循环本身不会等待任何工作线程。
+ */
+class completion_queue {
+   public:
+    completion_queue() {
+        m_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_eventfd < 0) {
+            throw std::exception();
+        }
+    }
+
+    ~completion_queue() { close(m_eventfd); }
+
+    /** @brief 注册到 epoll 中的 eventfd */
+    int fd() const { return m_eventfd; }
+
+    /** @brief 工作线程调用，回报 sockfd 上的任务已经完成 */
+    void post(int sockfd) {
+        m_locker.lock();
+        bool notify = m_done.empty();
+        m_done.push_back(sockfd);
+        m_locker.unlock();
+
+        if (notify) {
+            uint64_t one = 1;
+            ::write(m_eventfd, &one, sizeof(one));
+        }
+    }
+
+    /** @brief reactor 线程调用，取走当前所有已完成的连接 */
+    void drain(std::vector<int>& done) {
+        // 先清空 eventfd 计数再取队列，之后到达的结果一定会重新唤醒
+        uint64_t count;
+        ::read(m_eventfd, &count, sizeof(count));
+
+        m_locker.lock();
+        done.swap(m_done);
+        m_locker.unlock();
+    }
+
+   private:
+    int m_eventfd;
+    locker m_locker;
+    std::vector<int> m_done;
+};
+
+#endif  // !COMPLETION_QUEUE_H
@@ -0,0 +1,184 @@
+// 长连接 HTTP 压测客户端，用于比较 epoll 与 io_uring 后端：
+// http_bench [-a 地址] [-p 端口] [-c 连接数] [-d 秒数] [-u 路径]
+//
+// 单线程 epoll 驱动所有连接，每个连接发出请求、读完响应（按 Content-Length）后立即发下一个，
+// 统计每秒完成的请求数与平均延迟。分别以 -i 0 与 -i 1 启动服务器后各运行一次即可对比两个后端。
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+struct bench_conn {
+    int fd;
+    std::string in;  // 当前响应已读到的数据
+    double sent;     // 当前请求的发出时间
+};
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int connect_to(const sockaddr_in& addr) {
+    int fd = socket(PF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (const sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// 响应完整时返回它的总长度，否则返回 0；响应没有 Content-Length 时返回 -1
+static long response_length(const std::string& in) {
+    size_t head = in.find("\r\n\r\n");
+    if (head == std::string::npos) {
+        return 0;
+    }
+    long length = -1;
+    for (size_t line = 0; line < head;) {
+        size_t eol = in.find("\r\n", line);
+        if (eol - line > 15 && strncasecmp(in.data() + line, "Content-Length:", 15) == 0) {
+            length = atol(in.data() + line + 15);
+        }
+        line = eol + 2;
+    }
+    if (length < 0) {
+        return -1;
+    }
+    long total = head + 4 + length;
+    return (long)in.size() >= total ? total : 0;
+}
+
+int main(int argc, char* argv[]) {
+    const char* host = "127.0.0.1";
+    int port = 9006;
+    int conns = 100;
+    int seconds = 10;
+    const char* url = "/welcome.html";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:p:c:d:u:")) != -1) {
+        switch (opt) {
+            case 'a':
+                host = optarg;
+                break;
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'c':
+                conns = atoi(optarg);
+                break;
+            case 'd':
+                seconds = atoi(optarg);
+                break;
+            case 'u':
+                url = optarg;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-a addr] [-p port] [-c conns] [-d seconds] [-u path]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, host, &addr.sin_addr);
+
+    std::string request =
+        std::string("GET ") + url + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: keep-alive\r\n\r\n";
+
+    int epollfd = epoll_create(5);
+    std::vector<bench_conn> clients(conns);
+    for (int i = 0; i < conns; ++i) {
+        clients[i].fd = connect_to(addr);
+        if (clients[i].fd < 0) {
+            fprintf(stderr, "connect to %s:%d failed: %s\n", host, port, strerror(errno));
+            return 1;
+        }
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        epoll_ctl(epollfd, EPOLL_CTL_ADD, clients[i].fd, &event);
+    }
+
+    long done = 0;
+    long errors = 0;
+    double latency = 0;
+    int active = conns;
+    double start = now_sec();
+    double deadline = start + seconds;
+    for (int i = 0; i < conns; ++i) {
+        clients[i].sent = now_sec();
+        send(clients[i].fd, request.data(), request.size(), 0);
+    }
+
+    std::vector<epoll_event> events(conns);
+    char buf[65536];
+    while (active > 0) {
+        int n = epoll_wait(epollfd, events.data(), conns, 1000);
+        double now = now_sec();
+        for (int e = 0; e < n; ++e) {
+            bench_conn& c = clients[events[e].data.u32];
+            ssize_t len;
+            bool closed = false;
+            while ((len = recv(c.fd, buf, sizeof(buf), 0)) > 0) {
+                c.in.append(buf, len);
+            }
+            if (len == 0 || (len < 0 && errno != EAGAIN)) {
+                closed = true;
+            }
+
+            long total;
+            while ((total = response_length(c.in)) > 0) {
+                ++done;
+                latency += now - c.sent;
+                c.in.erase(0, total);
+                if (now < deadline && !closed) {
+                    c.sent = now;
+                    send(c.fd, request.data(), request.size(), 0);
+                } else {
+                    closed = true;
+                }
+            }
+            if (total < 0 || closed) {
+                if (total < 0 || now < deadline) {
+                    ++errors;
+                }
+                epoll_ctl(epollfd, EPOLL_CTL_DEL, c.fd, 0);
+                close(c.fd);
+                --active;
+            }
+        }
+        if (now_sec() > deadline + 5) {
+            break;
+        }
+    }
+    double elapsed = now_sec() - start;
+
+    printf("%ld requests in %.2fs over %d connections, %ld errors\n", done, elapsed, conns, errors);
+    printf("requests/s: %.0f\n", done / elapsed);
+    printf("latency avg: %.1f us\n", done ? latency / done * 1e6 : 0);
+    return 0;
+}
@@ -0,0 +1,330 @@
+#include "sub_reactor.h"
+
+#include "../webserver.h"
+
+sub_reactor::sub_reactor()
+    : m_epollfd(-1),
+      m_server(NULL),
+      m_close_log(0),
+      m_own_epollfd(false),
+      m_events(NULL),
+      m_timerfd(-1),
+      m_listenfd(-1),
+      m_running(false),
+      m_stop(false),
+      m_conn_count(0) {
+    m_wakeupfd[0] = m_wakeupfd[1] = -1;
+}
+
+sub_reactor::~sub_reactor() {
+    stop();
+    if (m_own_epollfd) {
+        close(m_epollfd);
+    }
+    if (m_listenfd != -1) {
+        close(m_listenfd);
+    }
+    if (m_timerfd != -1) {
+        close(m_timerfd);
+    }
+    if (m_wakeupfd[0] != -1) {
+        close(m_wakeupfd[0]);
+        close(m_wakeupfd[1]);
+    }
+    delete[] m_events;
+}
+
+void sub_reactor::init(WebServer* server, int epollfd) {
+    m_server = server;
+    m_close_log = server->m_close_log;
+    m_utils.init(TIMESLOT);
+    m_timerfd = m_utils.create_timerfd();
+
+    if (epollfd != -1) {
+        // 单 reactor 模式，与主 reactor 共用内核事件表，由主线程驱动
+        m_epollfd = epollfd;
+        m_utils.addfd(m_epollfd, m_completion.fd(), false, 0);
+        m_utils.addfd(m_epollfd, m_timerfd, false, 0);
+        return;
+    }
+
+    m_epollfd = epoll_create(5);
+    assert(m_epollfd != -1);
+    m_own_epollfd = true;
+    m_events = new epoll_event[MAX_EVENT_NUMBER];
+    m_utils.addfd(m_epollfd, m_completion.fd(), false, 0);
+    m_utils.addfd(m_epollfd, m_timerfd, false, 0);
+
+    int ret = socketpair(PF_UNIX, SOCK_STREAM, 0, m_wakeupfd);
+    assert(ret != -1);
+    m_utils.setnonblocking(m_wakeupfd[1]);
+    m_utils.addfd(m_epollfd, m_wakeupfd[0], false, 0);
+}
+
+void sub_reactor::listen_on(int listenfd) {
+    m_listenfd = listenfd;
+    m_utils.addfd(m_epollfd, m_listenfd, false, m_server->m_LISTENTrigmode);
+}
+
+void sub_reactor::start() {
+    if (pthread_create(&m_thread, NULL, worker, this) != 0) {
+        throw std::exception();
+    }
+    m_running = true;
+}
+
+void sub_reactor::stop() {
+    if (!m_running) {
+        return;
+    }
+    char msg = 'q';
+    send(m_wakeupfd[1], &msg, 1, 0);
+    pthread_join(m_thread, NULL);
+    m_running = false;
+}
+
+void sub_reactor::add_conn(int connfd, const sockaddr_in& client_address) {
+    client_data data;
+    data.address = client_address;
+    data.sockfd = connfd;
+    data.timer = NULL;
+
+    // 先计数，保证连续分发时最少连接策略能看到刚投递的连接
+    m_conn_count.fetch_add(1, std::memory_order_relaxed);
+
+    m_pending_locker.lock();
+    m_pending.push_back(data);
+    m_pending_locker.unlock();
+
+    char msg = 'c';
+    send(m_wakeupfd[1], &msg, 1, 0);
+}
+
+void* sub_reactor::worker(void* arg) {
+    sub_reactor* reactor = (sub_reactor*)arg;
+    reactor->loop();
+    return reactor;
+}
+
+void sub_reactor::loop() {
+    while (!m_stop) {
+        int number = epoll_wait(m_epollfd, m_events, MAX_EVENT_NUMBER, -1);
+        if (number < 0 && errno != EINTR) {
+            LOG_ERROR("%s", "sub reactor epoll failure");
+            break;
+        }
+
+        for (int i = 0; i < number; i++) {
+            int sockfd = m_events[i].data.fd;
+            if (sockfd == m_listenfd) {
+                m_server->deal_clientData(m_listenfd, this);
+            } else if (sockfd == m_wakeupfd[0]) {
+                deal_wakeup();
+            } else {
+                handle_event(m_events[i]);
+            }
+        }
+    }
+}
+
+void sub_reactor::deal_wakeup() {
+    char msgs[1024];
+    int ret = recv(m_wakeupfd[0], msgs, sizeof(msgs), 0);
+    for (int i = 0; i < ret; i++) {
+        if (msgs[i] == 'q') {
+            m_stop = true;
+        }
+    }
+
+    std::list<client_data> pending;
+    m_pending_locker.lock();
+    pending.swap(m_pending);
+    m_pending_locker.unlock();
+
+    for (std::list<client_data>::iterator it = pending.begin(); it != pending.end(); ++it) {
+        // add_conn 已经计过数，timer 中会再加一次
+        m_conn_count.fetch_sub(1, std::memory_order_relaxed);
+        timer(it->sockfd, it->address);
+    }
+}
+
+void sub_reactor::timer(int connfd, const sockaddr_in& client_address) {
+    WebServer* server = m_server;
+    server->users[connfd].init(m_epollfd, &m_completion, connfd, client_address, server->m_root, server->m_CONNTrigmode,
+                               m_close_log, server->m_zerocopy);
+
+    // 初始化 client_data 数据
+    // 使用嵌入的定时器节点，设置回调函数和超时时间，绑定用户数据，将定时器添加到时间轮中
+    client_data* data = &server->users_timer[connfd];
+    data->address = client_address;
+    data->sockfd = connfd;
+    data->epollfd = m_epollfd;
+    data->conn = &server->users[connfd];
+    data->in_flight = 0;
+    data->close_pending = false;
+
+    util_timer* timer = &data->timer_node;
+    timer->user_data = data;
+    timer->cb_func = cb_func;
+    timer->expire = Utils::now_ms() + IDLE_TIMEOUT;
+
+    data->timer = timer;
+    m_utils.m_timer_wheel.add_timer(timer);
+    m_conn_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void sub_reactor::handle_event(const epoll_event& event) {
+    int sockfd = event.data.fd;
+
+    if (sockfd == m_completion.fd()) {
+        // 工作线程回报的读写结果
+        deal_completion();
+    } else if (sockfd == m_timerfd) {
+        tick();
+    } else if (event.events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        // 服务器端关闭连接，移除对应的定时器
+        util_timer* timer = m_server->users_timer[sockfd].timer;
+        deal_timer(timer, sockfd);
+    } else if (event.events & EPOLLIN) {
+        // 处理客户连接上接收到的数据
+        deal_with_read(sockfd);
+    } else if (event.events & EPOLLOUT) {
+        deal_with_write(sockfd);
+    }
+}
+
+// reactor 模式下处理工作线程完成的读写：失败的连接在这里关闭并删除定时器
+void sub_reactor::deal_completion() {
+    fd_table<http_conn>& users = m_server->users;
+    m_completion.drain(m_done);
+
+    for (size_t i = 0; i < m_done.size(); i++) {
+        int sockfd = m_done[i];
+        client_data* data = &m_server->users_timer[sockfd];
+        --data->in_flight;
+        if (1 == users[sockfd].timer_flag) {
+            deal_timer(data->timer, sockfd);
+            users[sockfd].timer_flag = 0;
+        }
+        // 处理期间已超时：定时器节点已离开时间轮，连接计数也已减去，只需关闭
+        if (data->close_pending && 0 == data->in_flight) {
+            data->close_pending = false;
+            cb_func(data);
+        }
+    }
+    m_done.clear();
+}
+
+void sub_reactor::tick() {
+    uint64_t expirations;
+    read(m_timerfd, &expirations, sizeof(expirations));
+
+    int expired = m_utils.m_timer_wheel.tick();
+    m_conn_count.fetch_sub(expired, std::memory_order_relaxed);
+}
+
+// 若有数据传输，则推迟定时器：请求读到一半时按请求头超时，否则按长连接空闲超时
+// 时间轮只在超时时间提前时移动节点，推迟时惰性重排
+void sub_reactor::adjust_timer(util_timer* timer, int sockfd) {
+    int timeout = m_server->users[sockfd].in_request() ? HEADER_TIMEOUT : KEEPALIVE_TIMEOUT;
+    timer->expire = Utils::now_ms() + timeout;
+    m_utils.m_timer_wheel.adjust_timer(timer);
+
+    LOG_DEBUG("%s", "adjust timer once");
+}
+
+void sub_reactor::deal_timer(util_timer* timer, int sockfd) {
+    // 同一批就绪事件中可能还有已关闭连接的事件，此时定时器已被删除
+    if (!timer) {
+        return;
+    }
+
+    client_data* data = &m_server->users_timer[sockfd];
+    timer->cb_func(data);
+    m_utils.m_timer_wheel.del_timer(timer);
+    data->timer = NULL;
+    m_conn_count.fetch_sub(1, std::memory_order_relaxed);
+
+    LOG_DEBUG("close fd %d", data->sockfd);
+}
+
+// 只有入队成功的任务会回报完成，计数与 deal_completion 中的递减一一对应
+void sub_reactor::dispatch(int sockfd, int state) {
+    if (m_server->m_pool->append(&m_server->users[sockfd], state)) {
+        ++m_server->users_timer[sockfd].in_flight;
+    }
+}
+
+void sub_reactor::deal_with_read(int sockfd) {
+    fd_table<http_conn>& users = m_server->users;
+    util_timer* timer = m_server->users_timer[sockfd].timer;
+
+    if (1 == m_server->m_actormodel) {
+        // reactor
+
+        if (!timer) {
+            return;
+        }
+        adjust_timer(timer, sockfd);
+
+        // 若监测到读事件，将该事件放入请求队列，结果由工作线程通过完成队列异步回报
+        dispatch(sockfd, 0);
+    } else {
+        // proactor
+
+        if (users[sockfd].read_once()) {
+            // 小文件的 GET 命中响应缓存时在本线程直接发送，省去交给工作线程再回到事件循环的两次切换
+            if (users[sockfd].serve_cached()) {
+                deal_with_write(sockfd);
+                return;
+            }
+
+            LOG_DEBUG("deal with the client(%s)", inet_ntoa(users[sockfd].get_address()->sin_addr));
+
+            // 若监测到读事件，将该事件放入请求队列
+            m_server->m_pool->append_p(&users[sockfd]);
+
+            if (timer) {
+                adjust_timer(timer, sockfd);
+            }
+        } else {
+            deal_timer(timer, sockfd);
+        }
+    }
+}
+
+void sub_reactor::deal_with_write(int sockfd) {
+    fd_table<http_conn>& users = m_server->users;
+    util_timer* timer = m_server->users_timer[sockfd].timer;
+
+    if (1 == m_server->m_actormodel) {
+        // reactor
+
+        if (!timer) {
+            return;
+        }
+        adjust_timer(timer, sockfd);
+
+        // 若监测到写事件，将该事件放入请求队列，结果由工作线程通过完成队列异步回报
+        dispatch(sockfd, 1);
+    } else {
+        // proactor
+
+        http_conn::WRITE_RESULT ret = users[sockfd].write();
+        if (http_conn::WRITE_CLOSE != ret) {
+            LOG_DEBUG("send data to the client(%s)", inet_ntoa(users[sockfd].get_address()->sin_addr));
+
+            // 本批响应已全部发出且读缓冲链中还有流水线请求，不必等待读事件，直接交给工作线程处理；
+            // 部分发送时等待可写事件发完剩余数据，不能让工作线程与本线程同时操作连接
+            if (http_conn::WRITE_CONTINUE == ret) {
+                m_server->m_pool->append_p(&users[sockfd]);
+            }
+
+            if (timer) {
+                adjust_timer(timer, sockfd);
+            }
+        } else {
+            deal_timer(timer, sockfd);
+        }
+    }
+}
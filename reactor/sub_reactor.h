@@ -0,0 +1,101 @@
+#ifndef SUB_REACTOR_H
+#define SUB_REACTOR_H
+
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+
+#include <atomic>
+#include <list>
+
+#include "../http/http_conn.h"
+#include "../lock/locker.h"
+#include "../timer/lst_timer.h"
+#include "completion_queue.h"
+
+class WebServer;
+
+/**
+ * @brief 从 reactor：独占一个 epoll 内核事件表、一组连接以及对应的定时器链表
+ *
+ * 主 reactor 只负责 accept，新连接通过 add_conn() 投递到某个从 reactor，
+ * 之后该连接上的所有读写事件与超时处理都只在这个从 reactor 的线程内完成。
+ * 单 reactor 模式下，主线程直接复用一个不启动线程的 sub_reactor 处理连接事件。
+ */
+class sub_reactor {
+   public:
+    sub_reactor();
+    ~sub_reactor();
+
+    /**
+     * @brief 初始化从 reactor
+     *
+     * @param server  所属的 WebServer，用于访问连接数组、线程池等共享资源
+     * @param epollfd 复用的内核事件表，为 -1 时自行创建
+     */
+    void init(WebServer* server, int epollfd = -1);
+
+    /** @brief 由本 reactor 监听一个 SO_REUSEPORT socket，并在本线程内 accept */
+    void listen_on(int listenfd);
+
+    /** @brief 创建独立线程运行事件循环 */
+    void start();
+
+    /** @brief 通知事件循环线程退出并等待其结束 */
+    void stop();
+
+    /** @brief 由主 reactor 调用，将新连接投递给本 reactor（线程安全）*/
+    void add_conn(int connfd, const sockaddr_in& client_address);
+
+    /** @brief 在本 reactor 线程内初始化连接并创建定时器 */
+    void timer(int connfd, const sockaddr_in& client_address);
+
+    /** @brief 处理一个连接上的就绪事件 */
+    void handle_event(const epoll_event& event);
+
+    /** @brief timerfd 触发时处理到期的定时器 */
+    void tick();
+
+    /** @brief 当前由本 reactor 管理的连接数，用于最少连接分发 */
+    int conn_count() const { return m_conn_count.load(std::memory_order_relaxed); }
+
+   public:
+    int m_epollfd;
+
+   private:
+    static void* worker(void* arg);
+    void loop();
+    void deal_wakeup();
+    void deal_completion();
+    void adjust_timer(util_timer* timer, int sockfd);
+    void deal_timer(util_timer* timer, int sockfd);
+    void deal_with_read(int sockfd);
+    void deal_with_write(int sockfd);
+
+    /** @brief reactor 模式下把读（state 为 0）或写（1）交给工作线程，记录连接正在处理中 */
+    void dispatch(int sockfd, int state);
+
+   private:
+    WebServer* m_server;
+    int m_close_log;
+    bool m_own_epollfd;  // 内核事件表是否由本对象创建
+    epoll_event* m_events;
+    Utils m_utils;  // 本 reactor 独立的定时器链表
+    int m_timerfd;  // 周期触发的 timerfd，驱动本 reactor 的定时器链表
+    int m_listenfd;  // 本 reactor 独占的监听 socket，-1 表示由主 reactor accept
+
+    pthread_t m_thread;
+    bool m_running;
+    bool m_stop;
+    int m_wakeupfd[2];  // 主 reactor 投递连接或退出通知时写入
+
+    locker m_pending_locker;          // 保护待注册连接队列
+    std::list<client_data> m_pending;  // 主 reactor 投递、尚未注册的连接
+
+    completion_queue m_completion;  // reactor 模式下工作线程回报读写结果
+    std::vector<int> m_done;         // 从完成队列取出的连接，复用以免每次分配
+
+    std::atomic<int> m_conn_count;
+};
+
+#endif  // !SUB_REACTOR_H
@@ -0,0 +1,469 @@
+#include "uring_reactor.h"
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "../webserver.h"
+
+const unsigned URING_ENTRIES = 1024;                                 // 提交队列长度
+const unsigned URING_BUF_COUNT = 1024;                               // provided buffer 个数，必须是 2 的幂
+const unsigned URING_BUF_SIZE = http_conn::READ_BUFFER_SIZE;         // 单个接收缓冲区大小
+const unsigned short URING_BUF_GROUP = 0;                            // 缓冲区组号
+
+// user_data 高 32 位为操作类型，低 32 位为 fd
+enum URING_OP { URING_ACCEPT = 1, URING_RECV, URING_WRITEV, URING_TICK, URING_STOP, URING_PROVIDE };
+
+static inline uint64_t make_user_data(URING_OP op, int fd) { return ((uint64_t)op << 32) | (uint32_t)fd; }
+
+// 超时回调：只关闭读写方向，让在飞的 recv/writev 完成后由 close_conn 真正关闭描述符
+static void uring_cb_func(client_data* user_data) {
+    assert(user_data);
+    shutdown(user_data->sockfd, SHUT_RDWR);
+    user_data->timer = NULL;
+}
+
+uring_reactor::uring_reactor()
+    : m_server(NULL),
+      m_close_log(0),
+      m_listenfd(-1),
+      m_ring_fd(-1),
+      m_sq_ptr(NULL),
+      m_sq_size(0),
+      m_cq_ptr(NULL),
+      m_cq_size(0),
+      m_sqes(NULL),
+      m_sqes_size(0),
+      m_sq_local_tail(0),
+      m_to_submit(0),
+      m_bufs(NULL),
+      m_running(false),
+      m_stop(false),
+      m_stopfd(-1),
+      m_stop_val(0) {}
+
+uring_reactor::~uring_reactor() {
+    stop();
+    if (m_sqes) {
+        munmap(m_sqes, m_sqes_size);
+    }
+    if (m_cq_ptr && m_cq_ptr != m_sq_ptr) {
+        munmap(m_cq_ptr, m_cq_size);
+    }
+    if (m_sq_ptr) {
+        munmap(m_sq_ptr, m_sq_size);
+    }
+    if (m_ring_fd != -1) {
+        close(m_ring_fd);
+    }
+    if (m_stopfd != -1) {
+        close(m_stopfd);
+    }
+    delete[] m_bufs;
+}
+
+bool uring_reactor::init(WebServer* server, int listenfd) {
+    m_server = server;
+    m_close_log = server->m_close_log;
+    m_listenfd = listenfd;
+    m_utils.init(TIMESLOT);
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    m_ring_fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (m_ring_fd < 0) {
+        return false;
+    }
+
+    // 映射提交队列、完成队列和 SQE 数组
+    m_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        m_sq_size = m_cq_size = m_sq_size > m_cq_size ? m_sq_size : m_cq_size;
+    }
+
+    void* ptr = mmap(0, m_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQ_RING);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+    m_sq_ptr = ptr;
+
+    if (single_mmap) {
+        m_cq_ptr = m_sq_ptr;
+    } else {
+        ptr = mmap(0, m_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_CQ_RING);
+        if (ptr == MAP_FAILED) {
+            return false;
+        }
+        m_cq_ptr = ptr;
+    }
+
+    m_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ptr = mmap(0, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQES);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+    m_sqes = (struct io_uring_sqe*)ptr;
+
+    char* sq = (char*)m_sq_ptr;
+    m_sq_head = (unsigned*)(sq + params.sq_off.head);
+    m_sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    m_sq_array = (unsigned*)(sq + params.sq_off.array);
+    m_sq_mask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    m_sq_entries = params.sq_entries;
+    m_sq_local_tail = *m_sq_tail;
+
+    char* cq = (char*)m_cq_ptr;
+    m_cq_head = (unsigned*)(cq + params.cq_off.head);
+    m_cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    m_cq_mask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    m_cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    // 接收缓冲区以 IORING_OP_PROVIDE_BUFFERS 交给内核，recv 完成时由内核挑选一个并在 CQE 中给出编号
+    m_bufs = new char[URING_BUF_COUNT * URING_BUF_SIZE];
+    if (!provide_buffers()) {
+        return false;
+    }
+
+    m_stopfd = eventfd(0, EFD_CLOEXEC);
+    if (m_stopfd < 0) {
+        return false;
+    }
+
+    m_tick_ts.tv_sec = TIMESLOT / 1000;
+    m_tick_ts.tv_nsec = (TIMESLOT % 1000) * 1000000L;
+    return true;
+}
+
+// 提交已填写的 SQE 并同步等待一个完成事件，只在事件循环启动前使用
+int uring_reactor::run_sync() {
+    if (submit_and_wait(1) < 0) {
+        return -errno;
+    }
+
+    unsigned head = *m_cq_head;
+    struct io_uring_cqe* cqe = &m_cqes[head & m_cq_mask];
+    int res = cqe->res;
+    __atomic_store_n(m_cq_head, head + 1, __ATOMIC_RELEASE);
+    return res;
+}
+
+// 通过 IORING_OP_PROVIDE_BUFFERS 一次性把所有缓冲区交给内核
+bool uring_reactor::provide_buffers() {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = URING_BUF_COUNT;
+    sqe->addr = (uint64_t)m_bufs;
+    sqe->len = URING_BUF_SIZE;
+    sqe->off = 0;
+    sqe->buf_group = URING_BUF_GROUP;
+
+    return run_sync() >= 0;
+}
+
+void uring_reactor::start() {
+    if (pthread_create(&m_thread, NULL, worker, this) != 0) {
+        throw std::exception();
+    }
+    m_running = true;
+}
+
+void uring_reactor::stop() {
+    if (!m_running) {
+        return;
+    }
+    uint64_t one = 1;
+    ::write(m_stopfd, &one, sizeof(one));
+    pthread_join(m_thread, NULL);
+    m_running = false;
+}
+
+void* uring_reactor::worker(void* arg) {
+    uring_reactor* reactor = (uring_reactor*)arg;
+    reactor->loop();
+    return reactor;
+}
+
+void uring_reactor::loop() {
+    submit_accept();
+    submit_tick();
+    submit_stop_read();
+
+    while (!m_stop) {
+        // 一次系统调用提交上一轮产生的所有 SQE，并等待至少一个完成事件
+        int ret = submit_and_wait(1);
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            LOG_ERROR("io_uring_enter failure, errno is:%d", errno);
+            break;
+        }
+
+        unsigned head = *m_cq_head;
+        unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            deal_cqe(&m_cqes[head & m_cq_mask]);
+        }
+        __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+
+struct io_uring_sqe* uring_reactor::get_sqe() {
+    // 提交队列已满时先把已填写的 SQE 交给内核
+    while (m_sq_local_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) >= m_sq_entries) {
+        submit_and_wait(0);
+    }
+
+    unsigned idx = m_sq_local_tail & m_sq_mask;
+    struct io_uring_sqe* sqe = &m_sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    m_sq_array[idx] = idx;
+    m_sq_local_tail++;
+    m_to_submit++;
+    return sqe;
+}
+
+int uring_reactor::submit_and_wait(unsigned wait_nr) {
+    __atomic_store_n(m_sq_tail, m_sq_local_tail, __ATOMIC_RELEASE);
+
+    unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int ret = syscall(__NR_io_uring_enter, m_ring_fd, m_to_submit, wait_nr, flags, NULL, 0);
+    if (ret > 0) {
+        m_to_submit -= ret;
+    }
+    return ret;
+}
+
+void uring_reactor::submit_accept() {
+    m_client_addrlen = sizeof(m_client_address);
+
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = m_listenfd;
+    sqe->addr = (uint64_t)&m_client_address;
+    sqe->addr2 = (uint64_t)&m_client_addrlen;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = make_user_data(URING_ACCEPT, m_listenfd);
+}
+
+void uring_reactor::submit_recv(int fd) {
+    // 不指定缓冲区，由内核在数据到达时从缓冲区组中挑选
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->len = URING_BUF_SIZE;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUF_GROUP;
+    sqe->user_data = make_user_data(URING_RECV, fd);
+}
+
+void uring_reactor::submit_writev(int fd) {
+    http_conn* conn = &m_server->users[fd];
+
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)conn->get_iovec();
+    sqe->len = conn->get_iov_count();
+    sqe->user_data = make_user_data(URING_WRITEV, fd);
+}
+
+void uring_reactor::submit_tick() {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)&m_tick_ts;
+    sqe->len = 1;
+    sqe->user_data = make_user_data(URING_TICK, -1);
+}
+
+void uring_reactor::submit_stop_read() {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = m_stopfd;
+    sqe->addr = (uint64_t)&m_stop_val;
+    sqe->len = sizeof(m_stop_val);
+    sqe->user_data = make_user_data(URING_STOP, m_stopfd);
+}
+
+void uring_reactor::deal_cqe(const struct io_uring_cqe* cqe) {
+    int fd = (int)(uint32_t)cqe->user_data;
+
+    switch (cqe->user_data >> 32) {
+        case URING_ACCEPT: {
+            deal_accept(cqe->res);
+            break;
+        }
+        case URING_RECV: {
+            deal_recv(fd, cqe->res, cqe->flags);
+            break;
+        }
+        case URING_WRITEV: {
+            deal_writev(fd, cqe->res);
+            break;
+        }
+        case URING_TICK: {
+            m_utils.m_timer_wheel.tick();
+            submit_tick();
+            break;
+        }
+        case URING_STOP: {
+            m_stop = true;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void uring_reactor::deal_accept(int res) {
+    // 始终保持一个 accept 在飞
+    submit_accept();
+
+    if (res < 0) {
+        LOG_ERROR("%s:errno is:%d", "accept error", -res);
+        return;
+    }
+
+    int connfd = res;
+    if (http_conn::m_user_count >= MAX_FD) {
+        m_utils.show_error(connfd, "Internal server busy");
+        LOG_ERROR("%s", "Internal server busy");
+        return;
+    }
+
+    WebServer* server = m_server;
+    // 响应通过 writev SQE 发送，不支持 sendfile，静态文件始终映射到内存
+    server->users[connfd].init(-1, NULL, connfd, m_client_address, server->m_root, server->m_CONNTrigmode,
+                               m_close_log, 0);
+
+    client_data* data = &server->users_timer[connfd];
+    data->address = m_client_address;
+    data->sockfd = connfd;
+    data->epollfd = -1;
+    data->conn = &server->users[connfd];
+
+    util_timer* timer = &data->timer_node;
+    timer->user_data = data;
+    timer->cb_func = uring_cb_func;
+    timer->expire = Utils::now_ms() + IDLE_TIMEOUT;
+    data->timer = timer;
+    m_utils.m_timer_wheel.add_timer(timer);
+
+    submit_recv(connfd);
+}
+
+void uring_reactor::deal_recv(int fd, int res, unsigned flags) {
+    if (res == -ENOBUFS) {
+        // 缓冲区组暂时耗尽，处理完本轮 CQE 后缓冲区会被归还
+        submit_recv(fd);
+        return;
+    }
+
+    if (res <= 0) {
+        if (flags & IORING_CQE_F_BUFFER) {
+            recycle_buffer(flags >> IORING_CQE_BUFFER_SHIFT);
+        }
+        close_conn(fd);
+        return;
+    }
+
+    http_conn* conn = &m_server->users[fd];
+    unsigned short bid = flags >> IORING_CQE_BUFFER_SHIFT;
+    bool ok = conn->append_read(m_bufs + bid * URING_BUF_SIZE, res);
+    recycle_buffer(bid);
+    if (!ok) {
+        close_conn(fd);
+        return;
+    }
+
+    LOG_DEBUG("deal with the client(%s)", inet_ntoa(conn->get_address()->sin_addr));
+    adjust_timer(fd);
+    process_request(fd);
+}
+
+// 解析读缓冲链中的请求，按结果提交 writev、继续 recv 或关闭连接
+void uring_reactor::process_request(int fd) {
+    http_conn* conn = &m_server->users[fd];
+    int ret;
+    {
+        connectionRAII mysqlconn(&conn->mysql, m_server->m_connPool);
+        ret = conn->handle_request();
+    }
+
+    if (0 == ret) {
+        submit_recv(fd);
+    } else if (ret > 0) {
+        submit_writev(fd);
+    } else {
+        close_conn(fd);
+    }
+}
+
+void uring_reactor::deal_writev(int fd, int res) {
+    http_conn* conn = &m_server->users[fd];
+
+    if (res == -EAGAIN || res == -EINTR) {
+        submit_writev(fd);
+        return;
+    }
+
+    if (res < 0) {
+        conn->unmap();
+        close_conn(fd);
+        return;
+    }
+
+    if (!conn->advance_send(res)) {
+        // 部分发送，继续提交剩余部分
+        submit_writev(fd);
+        return;
+    }
+
+    LOG_DEBUG("send data to the client(%s)", inet_ntoa(conn->get_address()->sin_addr));
+
+    if (conn->finish_response()) {
+        adjust_timer(fd);
+        // 读缓冲链中还有流水线请求时直接处理，不必先 recv
+        if (conn->in_request()) {
+            process_request(fd);
+        } else {
+            submit_recv(fd);
+        }
+    } else {
+        close_conn(fd);
+    }
+}
+
+// 把用完的缓冲区重新交还给内核，完成事件无需处理
+void uring_reactor::recycle_buffer(unsigned short bid) {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = 1;
+    sqe->addr = (uint64_t)(m_bufs + bid * URING_BUF_SIZE);
+    sqe->len = URING_BUF_SIZE;
+    sqe->off = bid;
+    sqe->buf_group = URING_BUF_GROUP;
+    sqe->user_data = make_user_data(URING_PROVIDE, -1);
+}
+
+void uring_reactor::close_conn(int fd) {
+    client_data* data = &m_server->users_timer[fd];
+    if (data->timer) {
+        m_utils.m_timer_wheel.del_timer(data->timer);
+        data->timer = NULL;
+    }
+
+    close(fd);
+    m_server->users[fd].release();
+
+    LOG_DEBUG("close fd %d", fd);
+}
+
+void uring_reactor::adjust_timer(int fd) {
+    util_timer* timer = m_server->users_timer[fd].timer;
+    if (timer) {
+        int timeout = m_server->users[fd].in_request() ? HEADER_TIMEOUT : KEEPALIVE_TIMEOUT;
+        timer->expire = Utils::now_ms() + timeout;
+        m_utils.m_timer_wheel.adjust_timer(timer);
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef URING_REACTOR_H
+#define URING_REACTOR_H
+
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "../http/http_conn.h"
+#include "../timer/lst_timer.h"
+
+class WebServer;
+
+/**
+ * @brief 基于 io_uring 的 I/O 后端，可替代 epoll + recv/writev
+ *
+ * accept、recv（从 provided buffers 缓冲区组中取缓冲区）、writev 和定时都以 SQE 提交，
+ * 每轮事件循环处理完所有 CQE 后用一次 io_uring_enter 批量提交新的 SQE 并等待完成。
+ * 请求解析与响应生成复用 http_conn 的状态机，在本线程内完成。
+ *
+ * 每个连接同一时刻只有一个 recv 或 writev 在飞，连接只在该请求完成时关闭，
+ * 因此 CQE 中的 fd 不会与复用了同一描述符的新连接混淆。
+ */
+class uring_reactor {
+   public:
+    uring_reactor();
+    ~uring_reactor();
+
+    /**
+     * @brief 创建 io_uring 实例并注册接收缓冲区
+     *
+     * @param server   所属的 WebServer
+     * @param listenfd 本 reactor 提交 accept 的监听 socket（阻塞模式）
+     * @return 内核不支持 io_uring 或 provided buffers 时返回 false，由调用方回退到 epoll
+     */
+    bool init(WebServer* server, int listenfd);
+
+    /** @brief 创建独立线程运行事件循环 */
+    void start();
+
+    /** @brief 通知事件循环线程退出并等待其结束 */
+    void stop();
+
+   private:
+    static void* worker(void* arg);
+    void loop();
+
+    // 提交队列
+    struct io_uring_sqe* get_sqe();
+    int submit_and_wait(unsigned wait_nr);
+    void submit_accept();
+    void submit_recv(int fd);
+    void submit_writev(int fd);
+    void submit_tick();
+    void submit_stop_read();
+
+    // 完成事件处理
+    void deal_cqe(const struct io_uring_cqe* cqe);
+    void deal_accept(int res);
+    void deal_recv(int fd, int res, unsigned flags);
+    void deal_writev(int fd, int res);
+    void process_request(int fd);
+
+    int run_sync();
+    bool provide_buffers();
+    void recycle_buffer(unsigned short bid);
+    void close_conn(int fd);
+    void adjust_timer(int fd);
+
+   private:
+    WebServer* m_server;
+    int m_close_log;
+    int m_listenfd;
+
+    // io_uring 实例
+    int m_ring_fd;
+    void* m_sq_ptr;
+    size_t m_sq_size;
+    void* m_cq_ptr;
+    size_t m_cq_size;
+    struct io_uring_sqe* m_sqes;
+    size_t m_sqes_size;
+    unsigned* m_sq_head;
+    unsigned* m_sq_tail;
+    unsigned* m_sq_array;
+    unsigned m_sq_mask;
+    unsigned m_sq_entries;
+    unsigned m_sq_local_tail;  // 已填写但尚未提交的 SQE 尾部
+    unsigned m_to_submit;
+    unsigned* m_cq_head;
+    unsigned* m_cq_tail;
+    unsigned m_cq_mask;
+    struct io_uring_cqe* m_cqes;
+
+    // 接收缓冲区组，recv 由内核从中挑选空闲缓冲区
+    char* m_bufs;
+
+    // accept 的输出参数，同一时刻只有一个 accept 在飞
+    sockaddr_in m_client_address;
+    socklen_t m_client_addrlen;
+
+    Utils m_utils;  // 本 reactor 的定时器链表
+    struct __kernel_timespec m_tick_ts;
+
+    pthread_t m_thread;
+    bool m_running;
+    bool m_stop;
+    int m_stopfd;  // eventfd，stop() 写入后对应的 read 完成，事件循环退出
+    uint64_t m_stop_val;
+};
+
+#endif  // !URING_REACTOR_H
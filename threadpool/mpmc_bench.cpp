@@ -0,0 +1,146 @@
+// 无锁 MPMC 队列与原先加锁队列的争用对比：mpmc_bench [每轮任务数]
+//
+// 生产者与消费者线程数相同，依次取 1、2、4、8、16，统计每秒完成的入队出队次数。
+// 加锁队列与原先的 threadpool 相同：std::list 由互斥锁保护，每次入队 post 信号量，出队前 wait。
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <list>
+#include <vector>
+
+#include "../lock/locker.h"
+#include "mpmc_queue.h"
+
+// 原先 threadpool 中的请求队列
+template <typename T>
+class locked_queue {
+   public:
+    explicit locked_queue(size_t max_requests) : m_max_requests(max_requests) {}
+
+    bool push(const T& item) {
+        m_queuelocker.lock();
+        if (m_workqueue.size() >= m_max_requests) {
+            m_queuelocker.unlock();
+            return false;
+        }
+        m_workqueue.push_back(item);
+        m_queuelocker.unlock();
+        m_queuestat.post();
+        return true;
+    }
+
+    void pop(T& item) {
+        while (true) {
+            m_queuestat.wait();
+            m_queuelocker.lock();
+            if (m_workqueue.empty()) {
+                m_queuelocker.unlock();
+                continue;
+            }
+            item = m_workqueue.front();
+            m_workqueue.pop_front();
+            m_queuelocker.unlock();
+            return;
+        }
+    }
+
+   private:
+    size_t m_max_requests;
+    std::list<T> m_workqueue;
+    locker m_queuelocker;
+    sem m_queuestat;
+};
+
+static const size_t QUEUE_SIZE = 10000;  // 与线程池默认的 max_requests 相同
+
+template <typename Q>
+struct bench_ctx {
+    Q* queue;
+    long items;  // 每个生产者放入的任务数
+};
+
+template <typename Q>
+static void* producer(void* arg) {
+    bench_ctx<Q>* ctx = (bench_ctx<Q>*)arg;
+    for (long i = 1; i <= ctx->items; ++i) {
+        // 队列满时与 append 失败后的处理一样，让出 CPU 再试
+        while (!ctx->queue->push((void*)i)) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+template <typename Q>
+static void* consumer(void* arg) {
+    bench_ctx<Q>* ctx = (bench_ctx<Q>*)arg;
+    void* item;
+    long sum = 0;
+    while (true) {
+        ctx->queue->pop(item);
+        // NULL 为结束标记
+        if (!item) {
+            break;
+        }
+        sum += (long)item;
+    }
+    return (void*)sum;
+}
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 返回每秒完成的任务数（百万）
+template <typename Q>
+static double run(Q& queue, int threads, long total) {
+    bench_ctx<Q> ctx = {&queue, total / threads};
+    std::vector<pthread_t> producers(threads), consumers(threads);
+
+    double start = now_sec();
+    for (int i = 0; i < threads; ++i) {
+        pthread_create(&consumers[i], NULL, consumer<Q>, &ctx);
+    }
+    for (int i = 0; i < threads; ++i) {
+        pthread_create(&producers[i], NULL, producer<Q>, &ctx);
+    }
+    for (int i = 0; i < threads; ++i) {
+        pthread_join(producers[i], NULL);
+    }
+    for (int i = 0; i < threads; ++i) {
+        while (!queue.push(NULL)) {
+            sched_yield();
+        }
+    }
+    for (int i = 0; i < threads; ++i) {
+        pthread_join(consumers[i], NULL);
+    }
+    return ctx.items * threads / (now_sec() - start) / 1e6;
+}
+
+int main(int argc, char* argv[]) {
+    long total = argc > 1 ? atol(argv[1]) : 2000000;
+    if (total <= 0) {
+        fprintf(stderr, "usage: %s [items]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%-10s %14s %14s\n", "threads", "locked Mops/s", "mpmc Mops/s");
+    const int counts[] = {1, 2, 4, 8, 16};
+    for (int threads : counts) {
+        locked_queue<void*> locked(QUEUE_SIZE);
+        mpmc_queue<void*> mpmc(QUEUE_SIZE);
+        double l = run(locked, threads, total);
+        double m = run(mpmc, threads, total);
+        char label[24];
+        snprintf(label, sizeof(label), "%d+%d", threads, threads);
+        printf("%-10s %14.2f %14.2f\n", label, l, m);
+    }
+    return 0;
+}
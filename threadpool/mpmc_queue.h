@@ -0,0 +1,159 @@
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <exception>
+
+#include "../lock/locker.h"
+
+/**
+ * @brief 有界无锁多生产者多消费者队列（Vyukov 环形缓冲区）
+ *
+ * 每个槽位带一个序号：序号等于入队位置时可写，等于入队位置 + 1 时可读。
+ * 生产者与消费者各自只对 m_enqueue_pos / m_dequeue_pos 做一次 CAS，入队出队不加锁也不分配内存。
+ *
+ * 队列为空时消费者先自旋等待，自旋上限根据最近是否自旋成功自适应调整；
+ * 仍为空时才挂起在信号量上，生产者只在有挂起的消费者时才 post，避免每次入队都进入内核。
+ */
+template <typename T>
+class mpmc_queue {
+   public:
+    /** @param capacity 队列容量，向上取整为 2 的幂 */
+    explicit mpmc_queue(size_t capacity) : m_waiters(0), m_spin_limit(SPIN_MIN) {
+        if (capacity == 0) {
+            throw std::exception();
+        }
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_mask = size - 1;
+
+        m_buffer = new cell[size];
+        for (size_t i = 0; i < size; i++) {
+            m_buffer[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        m_enqueue_pos.store(0, std::memory_order_relaxed);
+        m_dequeue_pos.store(0, std::memory_order_relaxed);
+    }
+
+    ~mpmc_queue() { delete[] m_buffer; }
+
+    /** @brief 入队，队列已满时返回 false */
+    bool push(const T& item) {
+        size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        cell* c;
+        while (true) {
+            c = &m_buffer[pos & m_mask];
+            size_t seq = c->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        c->data = item;
+        c->sequence.store(pos + 1, std::memory_order_release);
+
+        // 与消费者挂起前对 m_waiters 的修改配对，保证不会漏掉唤醒
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_waiters.load(std::memory_order_relaxed) > 0) {
+            m_sem.post();
+        }
+        return true;
+    }
+
+    /** @brief 非阻塞出队，队列为空时返回 false */
+    bool try_pop(T& item) {
+        size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        cell* c;
+        while (true) {
+            c = &m_buffer[pos & m_mask];
+            size_t seq = c->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        item = c->data;
+        c->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** @brief 阻塞出队：先自旋，仍取不到时挂起直到生产者唤醒 */
+    void pop(T& item) {
+        while (true) {
+            int limit = m_spin_limit.load(std::memory_order_relaxed);
+            for (int i = 0; i < limit; i++) {
+                if (try_pop(item)) {
+                    // 自旋等到了任务，下次可以多等一会
+                    if (limit < SPIN_MAX) {
+                        m_spin_limit.store(limit * 2, std::memory_order_relaxed);
+                    }
+                    return;
+                }
+                cpu_relax();
+            }
+            if (limit > SPIN_MIN) {
+                m_spin_limit.store(limit / 2, std::memory_order_relaxed);
+            }
+
+            // 先登记为等待者再检查一次队列，之后入队的生产者一定能看到登记并唤醒
+            m_waiters.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (try_pop(item)) {
+                m_waiters.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            m_sem.wait();
+            m_waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+   private:
+    static const int SPIN_MIN = 16;
+    static const int SPIN_MAX = 4096;
+    static const size_t CACHELINE = 64;
+
+    static void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#else
+        sched_yield();
+#endif
+    }
+
+    struct cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    // 入队、出队位置与等待计数分别占用独立的缓存行，避免伪共享
+    cell* m_buffer;
+    size_t m_mask;
+    char m_pad0[CACHELINE];
+    std::atomic<size_t> m_enqueue_pos;
+    char m_pad1[CACHELINE - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> m_dequeue_pos;
+    char m_pad2[CACHELINE - sizeof(std::atomic<size_t>)];
+    std::atomic<int> m_waiters;     // 挂起在信号量上的消费者个数
+    std::atomic<int> m_spin_limit;  // 当前自旋次数上限
+    sem m_sem;
+};
+
+#endif  // !MPMC_QUEUE_H
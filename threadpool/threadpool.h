@@ -3,18 +3,21 @@
 
 #include <pthread.h>
 
+#include <atomic>
 #include <cstdio>
 #include <exception>
-#include <list>
 
 #include "../CGImysql/sql_connection_pool.h"
 #include "../lock/locker.h"
+#include "mpmc_queue.h"
 
 template <typename T>
 class threadpool {
    public:
     // thread_number 是线程池中线程的数量，max_requests 是请求队列中最多允许的、等待处理的请求的数量
-    threadpool(int actor_model, connection_pool* connPool, int thread_number = 8, int max_request = 10000);
+    // steal 为 1 时每个工作线程拥有本地队列，按连接 fd 分配任务，空闲线程从其它线程的队列窃取
+    threadpool(int actor_model, connection_pool* connPool, int thread_number = 8, int max_request = 10000,
+               int steal = 0);
     ~threadpool();
 
     bool append(T* request, int state);
@@ -24,29 +27,62 @@ class threadpool {
     // 工作线程运行的函数，它不断从工作队列中取出任务并执行
     static void* worker(void* arg);
     void run();
+    void run_steal(int id);
+    void handle(T* request);
+
+    // 工作窃取模式
+    bool push_local(T* request);
+    bool take(int id, T*& request);
+    void wakeup(int id);
 
    private:
     int m_thread_number;          // 线程池中的线程数
     int m_max_requests;           // 请求队列中允许的最大请求数
     pthread_t* m_threads;         // 描述线程池的数组，其大小为 m_thread_number
-    std::list<T*> m_workqueue;    // 请求队列
-    locker m_queuelocker;         // 保护请求队列的互斥锁
-    sem m_queuestat;              // 是否有任务需要处理
+    mpmc_queue<T*> m_workqueue;   // 请求队列，无锁有界，空闲时工作线程先自旋再挂起
     connection_pool* m_connPool;  // 数据库
     int m_actor_model;            // 模型切换
+
+    int m_steal;                     // 调度模式，0 共享队列，1 工作窃取
+    std::atomic<int> m_next_id;      // 工作线程启动时领取的编号
+    mpmc_queue<T*>** m_local;        // 每个工作线程的本地队列
+    sem* m_local_sem;                // 每个工作线程挂起时等待的信号量
+    std::atomic<bool>* m_parked;     // 工作线程是否已挂起
+    std::atomic<int> m_parked_num;   // 已挂起的工作线程数，为 0 时入队不必寻找窃取者
 };
 
 template <typename T>
-threadpool<T>::threadpool(int actor_model, connection_pool* connPool, int thread_number, int max_request)
+threadpool<T>::threadpool(int actor_model, connection_pool* connPool, int thread_number, int max_request, int steal)
     : m_actor_model(actor_model),
       m_connPool(connPool),
       m_thread_number(thread_number),
       m_max_requests(max_request),
-      m_threads(NULL) {
+      m_threads(NULL),
+      m_workqueue(max_request > 0 ? max_request : 1),
+      m_steal(steal),
+      m_next_id(0),
+      m_local(NULL),
+      m_local_sem(NULL),
+      m_parked(NULL),
+      m_parked_num(0) {
     if (thread_number <= 0 || max_request <= 0) {
         throw std::exception();
     }
 
+    if (1 == m_steal) {
+        // 本地队列平分请求上限，工作线程启动前全部创建好
+        int local_requests = max_request / thread_number > 64 ? max_request / thread_number : 64;
+        m_local = new mpmc_queue<T*>*[m_thread_number];
+        for (int i = 0; i < m_thread_number; ++i) {
+            m_local[i] = new mpmc_queue<T*>(local_requests);
+        }
+        m_local_sem = new sem[m_thread_number];
+        m_parked = new std::atomic<bool>[m_thread_number];
+        for (int i = 0; i < m_thread_number; ++i) {
+            m_parked[i].store(false, std::memory_order_relaxed);
+        }
+    }
+
     m_threads = new pthread_t[m_thread_number];
     if (!m_threads) {
         throw std::exception();
@@ -68,81 +104,162 @@ threadpool<T>::threadpool(int actor_model, connection_pool* connPool, int thread
 template <typename T>
 threadpool<T>::~threadpool() {
     delete[] m_threads;
+    if (m_local) {
+        for (int i = 0; i < m_thread_number; ++i) {
+            delete m_local[i];
+        }
+        delete[] m_local;
+        delete[] m_local_sem;
+        delete[] m_parked;
+    }
 }
 
 template <typename T>
 bool threadpool<T>::append(T* request, int state) {
-    m_queuelocker.lock();
-    if (m_workqueue.size() >= m_max_requests) {
-        m_queuelocker.unlock();
-        return false;
-    }
     request->m_state = state;
-    m_workqueue.push_back(request);
-    m_queuelocker.unlock();
-    m_queuestat.post();
-    return true;
+    if (1 == m_steal) {
+        return push_local(request);
+    }
+    return m_workqueue.push(request);
 }
 
 template <typename T>
 bool threadpool<T>::append_p(T* request) {
-    m_queuelocker.lock();
-    if (m_workqueue.size() >= m_max_requests) {
-        m_queuelocker.unlock();
-        return false;
-    }
-    m_workqueue.push_back(request);
-    m_queuelocker.unlock();
-    m_queuestat.post();
-    return true;
+    if (1 == m_steal) {
+        return push_local(request);
+    }
+    return m_workqueue.push(request);
+}
+
+// 同一连接的任务总是进入同一个工作线程的本地队列，负载均衡时连接数据留在同一个核的缓存中
+template <typename T>
+bool threadpool<T>::push_local(T* request) {
+    int home = (unsigned)request->get_sockfd() % m_thread_number;
+
+    for (int i = 0; i < m_thread_number; ++i) {
+        int id = (home + i) % m_thread_number;
+        if (m_local[id]->push(request)) {
+            wakeup(id);
+            return true;
+        }
+    }
+    return false;
+}
+
+// 优先唤醒队列所属线程；它正忙时唤醒一个挂起的线程来窃取
+template <typename T>
+void threadpool<T>::wakeup(int id) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_parked[id].exchange(false)) {
+        m_local_sem[id].post();
+        return;
+    }
+
+    if (m_parked_num.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    for (int i = 1; i < m_thread_number; ++i) {
+        int thief = (id + i) % m_thread_number;
+        if (m_parked[thief].exchange(false)) {
+            m_local_sem[thief].post();
+            return;
+        }
+    }
+}
+
+// 先取本地队列，再依次从其它线程的队列窃取
+template <typename T>
+bool threadpool<T>::take(int id, T*& request) {
+    if (m_local[id]->try_pop(request)) {
+        return true;
+    }
+    for (int i = 1; i < m_thread_number; ++i) {
+        if (m_local[(id + i) % m_thread_number]->try_pop(request)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 template <typename T>
 void* threadpool<T>::worker(void* arg) {
     threadpool* pool = (threadpool*)arg;
-    pool->run();
+    if (1 == pool->m_steal) {
+        pool->run_steal(pool->m_next_id.fetch_add(1));
+    } else {
+        pool->run();
+    }
     return pool;
 }
 
 template <typename T>
 void threadpool<T>::run() {
     while (true) {
-        m_queuestat.wait();
-        m_queuelocker.lock();
-        if (m_workqueue.empty()) {
-            m_queuelocker.unlock();
-            continue;
-        }
-        T* request = m_workqueue.front();
-        m_workqueue.pop_front();
-        m_queuelocker.unlock();
+        T* request = NULL;
+        m_workqueue.pop(request);
         if (!request) {
             continue;
         }
+        handle(request);
+    }
+}
+
+template <typename T>
+void threadpool<T>::run_steal(int id) {
+    const int SPIN_ROUNDS = 64;
 
-        if (1 == m_actor_model) {
-            if (0 == request->m_state) {
-                if (request->read_once()) {
-                    request->improv = 1;
-                    connectionRAII mysqlconn(&request->mysql, m_connPool);
-                    request->process();
-                } else {
-                    request->improv = 1;
-                    request->timer_flag = 1;
-                }
+    while (true) {
+        T* request = NULL;
+        bool found = false;
+        for (int i = 0; i < SPIN_ROUNDS && !found; ++i) {
+            found = take(id, request);
+        }
+
+        if (!found) {
+            // 先登记挂起再检查一次，之后入队的生产者一定能看到登记并唤醒
+            m_parked_num.fetch_add(1, std::memory_order_relaxed);
+            m_parked[id].store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            found = take(id, request);
+            if (!found) {
+                m_local_sem[id].wait();
+            }
+            m_parked[id].store(false);
+            m_parked_num.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        if (found && request) {
+            handle(request);
+        }
+    }
+}
+
+template <typename T>
+void threadpool<T>::handle(T* request) {
+    if (1 == m_actor_model) {
+        if (0 == request->m_state) {
+            if (request->read_once()) {
+                connectionRAII mysqlconn(&request->mysql, m_connPool);
+                request->process();
             } else {
-                if (request->write()) {
-                    request->improv = 1;
-                } else {
-                    request->improv = 1;
-                    request->timer_flag = 1;
-                }
+                request->timer_flag = 1;
             }
         } else {
-            connectionRAII mysqlconn(&request->mysql, m_connPool);
-            request->process();
+            typename T::WRITE_RESULT ret = request->write();
+            if (T::WRITE_CLOSE == ret) {
+                request->timer_flag = 1;
+            } else if (T::WRITE_CONTINUE == ret) {
+                // 本批响应已全部发出，读缓冲链中还有流水线请求，接着处理
+                connectionRAII mysqlconn(&request->mysql, m_connPool);
+                request->process();
+            }
         }
+        // 通知所属 reactor 处理结果，reactor 线程不必等待
+        request->complete();
+    } else {
+        connectionRAII mysqlconn(&request->mysql, m_connPool);
+        request->process();
     }
 }
 
-#endif  // !THREADPOOL_H
\ No newline at end of file
+#endif  // !THREADPOOL_H
@@ -2,138 +2,166 @@
 
 #include "../http/http_conn.h"
 
-sort_timer_lst::sort_timer_lst() {
-    head = NULL;
-    tail = NULL;
-}
+timer_wheel::timer_wheel() : m_tick_ms(1), m_cur_tick(0) { memset(m_slots, 0, sizeof(m_slots)); }
 
-sort_timer_lst::~sort_timer_lst() {
-    util_timer* tmp = head;
-    while (tmp) {
-        head = tmp->next;
-        delete tmp;
-        tmp = head;
-    }
+// 定时器节点由 client_data 持有，时间轮析构时无需释放
+timer_wheel::~timer_wheel() {}
+
+void timer_wheel::init(int tick_ms) {
+    m_tick_ms = tick_ms;
+    m_cur_tick = Utils::now_ms() / m_tick_ms;
 }
 
-void sort_timer_lst::add_timer(util_timer* timer) {
-    if (!timer) {
-        return;
+// 超时时间向上取整到刻度，保证定时器不会提前触发
+uint64_t timer_wheel::expire_tick(const util_timer* timer) const {
+    if (timer->expire <= 0) {
+        return 0;
     }
+    return (timer->expire + m_tick_ms - 1) / m_tick_ms;
+}
 
-    if (!head) {
-        head = tail = timer;
-        return;
+void timer_wheel::link(util_timer* timer, uint64_t when) {
+    if (when <= m_cur_tick) {
+        when = m_cur_tick + 1;
     }
 
-    if (timer->expire < head->expire) {
-        timer->next = head;
-        head->prev = timer;
-        head = timer;
-        return;
+    uint64_t delta = when - m_cur_tick;
+    uint64_t max_delta = ((uint64_t)1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+    if (delta > max_delta) {
+        delta = max_delta;
+        when = m_cur_tick + delta;
     }
 
-    add_timer(timer, head);
-}
-
-void sort_timer_lst::adjust_timer(util_timer* timer) {
-    if (!timer) {
-        return;
+    // 按剩余刻度数选择层：剩余不足 64^(level+1) 个刻度的放在第 level 层
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= ((uint64_t)1 << (WHEEL_BITS * (level + 1)))) {
+        level++;
     }
+    int index = (when >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1);
 
-    util_timer* tmp = timer->next;
-    if (!tmp || (timer->expire < tmp->expire)) {
-        return;
+    util_timer** head = &m_slots[level][index];
+    timer->when = when;
+    timer->slot = head;
+    timer->prev = NULL;
+    timer->next = *head;
+    if (*head) {
+        (*head)->prev = timer;
     }
+    *head = timer;
+}
 
-    if (timer == head) {
-        head = head->next;
-        head->prev = NULL;
-        timer->next = NULL;
-        add_timer(timer, head);
-    } else {
+void timer_wheel::unlink(util_timer* timer) {
+    if (timer->prev) {
         timer->prev->next = timer->next;
+    } else {
+        *timer->slot = timer->next;
+    }
+    if (timer->next) {
         timer->next->prev = timer->prev;
-        add_timer(timer, timer->next);
     }
+    timer->prev = timer->next = NULL;
+    timer->slot = NULL;
 }
 
-void sort_timer_lst::del_timer(util_timer* timer) {
+void timer_wheel::add_timer(util_timer* timer) {
     if (!timer) {
         return;
     }
+    link(timer, expire_tick(timer));
+}
 
-    if ((timer == head) && (timer == tail)) {
-        delete timer;
-        head = NULL;
-        tail = NULL;
+void timer_wheel::adjust_timer(util_timer* timer) {
+    if (!timer || !timer->slot) {
         return;
     }
 
-    if (timer == head) {
-        head = head->next;
-        head->prev = NULL;
-        delete timer;
-        return;
+    // 超时时间推迟时留在原槽位，到期时再惰性重排；提前时才需要立即移动
+    uint64_t when = expire_tick(timer);
+    if (when < timer->when) {
+        unlink(timer);
+        link(timer, when);
     }
+}
 
-    if (timer == tail) {
-        tail = tail->prev;
-        tail->next = NULL;
-        delete timer;
+void timer_wheel::del_timer(util_timer* timer) {
+    if (!timer || !timer->slot) {
         return;
     }
-
-    timer->prev->next = timer->next;
-    timer->next->prev = timer->prev;
-    delete timer;
+    unlink(timer);
 }
 
-void sort_timer_lst::tick() {
-    if (!head) {
-        return;
-    }
+// 把高层当前槽中的定时器重新分散到低层
+void timer_wheel::cascade(int level) {
+    int index = (m_cur_tick >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1);
+    util_timer* tmp = m_slots[level][index];
+    m_slots[level][index] = NULL;
 
-    time_t cur = time(NULL);
-    util_timer* tmp = head;
     while (tmp) {
-        if (cur < tmp->expire) {
-            break;
-        }
-        tmp->cb_func(tmp->user_data);
-        head = tmp->next;
-        if (head) {
-            head->prev = NULL;
-        }
-        delete tmp;
-        tmp = head;
+        util_timer* next = tmp->next;
+        link(tmp, expire_tick(tmp));
+        tmp = next;
     }
 }
 
-void sort_timer_lst::add_timer(util_timer* timer, util_timer* lst_head) {
-    util_timer* prev = lst_head;
-    util_timer* tmp = prev->next;
-    while (tmp) {
-        if (timer->expire < tmp->expire) {
-            prev->next = timer;
-            timer->next = tmp;
-            tmp->prev = timer;
-            timer->prev = prev;
-            break;
+int timer_wheel::tick() {
+    int expired = 0;
+    uint64_t now = Utils::now_ms() / m_tick_ms;
+
+    while (m_cur_tick < now) {
+        m_cur_tick++;
+
+        // 低层转完一圈时从上一层取下一个槽
+        for (int level = 1; level < WHEEL_LEVELS; level++) {
+            if (m_cur_tick & (((uint64_t)1 << (WHEEL_BITS * level)) - 1)) {
+                break;
+            }
+            cascade(level);
         }
-        prev = tmp;
-        tmp = tmp->next;
-    }
 
-    if (!tmp) {
-        prev->next = timer;
-        timer->prev = prev;
-        timer->next = NULL;
-        tail = timer;
+        int index = m_cur_tick & (WHEEL_SIZE - 1);
+        util_timer* tmp = m_slots[0][index];
+        m_slots[0][index] = NULL;
+
+        while (tmp) {
+            util_timer* next = tmp->next;
+            tmp->prev = tmp->next = NULL;
+            tmp->slot = NULL;
+
+            if (expire_tick(tmp) <= m_cur_tick) {
+                tmp->cb_func(tmp->user_data);
+                expired++;
+            } else {
+                // 期间有过活动，按新的超时时间重新挂入
+                link(tmp, expire_tick(tmp));
+            }
+            tmp = next;
+        }
     }
+    return expired;
+}
+
+void Utils::init(int timeslot) {
+    m_TIMESLOT = timeslot;
+    m_timer_wheel.init(timeslot);
 }
 
-void Utils::init(int timeslot) { m_TIMESLOT = timeslot; }
+int64_t Utils::now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int Utils::create_timerfd() {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    assert(fd != -1);
+
+    struct itimerspec its;
+    its.it_interval.tv_sec = m_TIMESLOT / 1000;
+    its.it_interval.tv_nsec = (m_TIMESLOT % 1000) * 1000000L;
+    its.it_value = its.it_interval;
+    timerfd_settime(fd, 0, &its, NULL);
+    return fd;
+}
 
 // 对文件描述符设置非阻塞
 int Utils::setnonblocking(int fd) {
@@ -162,15 +190,6 @@ void Utils::addfd(int epollfd, int fd, bool one_shot, int TRIGMode) {
     setnonblocking(fd);
 }
 
-// 信号处理函数
-void Utils::sig_handler(int sig) {
-    // 为保证函数的可重入性，保留原来的 errno
-    int save_errno = errno;
-    int msg = sig;
-    send(u_pipefd[1], (char*)&msg, 1, 0);
-    errno = save_errno;
-}
-
 // 设置信号函数
 void Utils::addsig(int sig, void(handler)(int), bool restart) {
     struct sigaction sa;
@@ -183,24 +202,21 @@ void Utils::addsig(int sig, void(handler)(int), bool restart) {
     assert(sigaction(sig, &sa, NULL) != -1);
 }
 
-// 定时处理任务，重新定时以不断触发 SIGALRM 信号
-void Utils::timer_handler() {
-    m_timer_lst.tick();
-    alarm(m_TIMESLOT);
-}
-
 void Utils::show_error(int connfd, const char* info) {
     send(connfd, info, strlen(info), 0);
     close(connfd);
 }
 
-int* Utils::u_pipefd = 0;
-int Utils::u_epollfd = 0;
-
 class Utils;
 void cb_func(client_data* user_data) {
-    epoll_ctl(Utils::u_epollfd, EPOLL_CTL_DEL, user_data->sockfd, 0);
     assert(user_data);
+    user_data->timer = NULL;
+    // 工作线程还在处理这个连接，此时关闭的描述符可能立即被新连接复用，推迟到它回报完成后再关闭
+    if (user_data->in_flight > 0) {
+        user_data->close_pending = true;
+        return;
+    }
+    epoll_ctl(user_data->epollfd, EPOLL_CTL_DEL, user_data->sockfd, 0);
     close(user_data->sockfd);
-    http_conn::m_user_count--;
+    user_data->conn->release();
 }
@@ -16,6 +16,7 @@
 #include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <sys/wait.h>
@@ -24,44 +25,65 @@
 
 #include "../log/log.h"
 
-class util_timer;
+struct client_data;
+class http_conn;
 
-struct client_data {
-    sockaddr_in address;  // 客户端地址信息
-    int sockfd;           // 客户端 socket 描述符
-    util_timer* timer;    // 与该客户端关联的定时器
-};
-
-// 链表节点类 - 单个定时器对象
+// 定时器节点，侵入式地嵌入在 client_data 中，不再为每个连接单独分配
 class util_timer {
    public:
-    util_timer() : prev(NULL), next(NULL) {}
+    util_timer() : expire(0), when(0), cb_func(NULL), user_data(NULL), prev(NULL), next(NULL), slot(NULL) {}
 
    public:
-    time_t expire;  // 定时器超时时间点
+    int64_t expire;  // 定时器超时时间点（单调时钟，毫秒），有活动时只需推迟该值
 
+    uint64_t when;                  // 节点当前所在槽位对应的时间轮刻度
     void (*cb_func)(client_data*);  // 超时后的回调函数
     client_data* user_data;         // 客户端数据（socket、地址等）
-    util_timer* prev;               // 指向前一个定时器
-    util_timer* next;               // 指向后一个定时器
+    util_timer* prev;               // 槽内链表的前一个定时器
+    util_timer* next;               // 槽内链表的后一个定时器
+    util_timer** slot;              // 所在槽位的链表头，未挂入时间轮时为 NULL
+};
+
+struct client_data {
+    sockaddr_in address;    // 客户端地址信息
+    int sockfd;             // 客户端 socket 描述符
+    int epollfd;            // 连接所属 reactor 的内核事件表
+    http_conn* conn;        // 对应的连接对象，超时关闭时归还其缓冲区
+    util_timer* timer;      // 与该客户端关联的定时器，指向 timer_node，连接关闭后为 NULL
+    util_timer timer_node;  // 嵌入的定时器节点
+    int in_flight;          // reactor 模式下已交给工作线程、尚未回报完成的任务数，只由所属 reactor 访问
+    bool close_pending;     // 处理期间超时或出错，等最后一个任务回报完成后再关闭
 };
 
-// 链表管理类 - 管理多个定时器（util_timer）的升序链表
-class sort_timer_lst {
+// 分层时间轮 - 4 层、每层 64 个槽，添加、删除、推迟均为 O(1)
+//
+// 第 0 层每个槽对应一个刻度，第 i 层每个槽对应 64^i 个刻度；高层槽到期时把其中的定时器按剩余时间重新分散到低层。
+// 推迟超时时间只修改 expire，节点到达所在槽位时若尚未真正超时再重新挂入，称为惰性重排。
+class timer_wheel {
    public:
-    sort_timer_lst();
-    ~sort_timer_lst();
+    timer_wheel();
+    ~timer_wheel();
+
+    void init(int tick_ms);
 
     void add_timer(util_timer* timer);
-    void adjust_timer(util_timer* timer);
+    void adjust_timer(util_timer* timer);  // 调用前先修改 timer->expire
     void del_timer(util_timer* timer);
-    void tick();
+    int tick();  // 推进到当前时间，返回本次到期的定时器个数
 
    private:
-    void add_timer(util_timer* timer, util_timer* lst_head);
-
-    util_timer* head;
-    util_timer* tail;
+    static const int WHEEL_BITS = 6;
+    static const int WHEEL_SIZE = 1 << WHEEL_BITS;
+    static const int WHEEL_LEVELS = 4;
+
+    uint64_t expire_tick(const util_timer* timer) const;
+    void link(util_timer* timer, uint64_t when);
+    void unlink(util_timer* timer);
+    void cascade(int level);
+
+    int m_tick_ms;                                   // 一个刻度的毫秒数
+    uint64_t m_cur_tick;                             // 已经处理到的刻度
+    util_timer* m_slots[WHEEL_LEVELS][WHEEL_SIZE];  // 各槽位的双向链表头
 };
 
 class Utils {
@@ -71,28 +93,26 @@ class Utils {
 
     void init(int timeslot);
 
+    // 单调时钟的当前时间（毫秒），不受系统时间调整影响
+    static int64_t now_ms();
+
+    // 创建按 m_TIMESLOT 毫秒周期触发的 timerfd，注册到事件循环后驱动定时器链表
+    int create_timerfd();
+
     // 对文件描述符设置非阻塞
     int setnonblocking(int fd);
 
     // 将内核事件表注册读事件，ET 模式，选择开启 EPOLLONESHOT
     void addfd(int epollfd, int fd, bool one_shot, int TRIGMode);
 
-    // 信号处理函数
-    static void sig_handler(int sig);
-
     // 设置信号函数
     void addsig(int sig, void(handler)(int), bool restart = true);
 
-    // 定时处理任务，重新定时以不断触发 SIGNALRM 信号
-    void timer_handler();
-
     void show_error(int connfd, const char* info);
 
    public:
-    sort_timer_lst m_timer_lst;  // 定时器链表管理器
-    int m_TIMESLOT;              // 定时器定时槽（秒）
-    static int* u_pipefd;        // 信号通过管道通知主线程
-    static int u_epollfd;        // epoll 文件描述符，用于信号集成
+    timer_wheel m_timer_wheel;   // 定时器时间轮
+    int m_TIMESLOT;              // 定时器检查间隔（毫秒）
 };
 
 void cb_func(client_data* user_data);
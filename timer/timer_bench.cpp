@@ -0,0 +1,219 @@
+// 时间轮与原先的升序链表定时器的对比：timer_bench [每项操作次数]
+//
+// 对 1k、10k、100k 个已有定时器，分别计时新增、推迟（有活动的连接把超时时间推到最后）与删除的平均耗时。
+// 新连接和有活动的连接的超时时间总是最晚的，与服务器中的实际情况相同，这也是链表的最坏情况。
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "lst_timer.h"
+
+// 原先的 sort_timer_lst，节点由调用方持有，只保留与计时相关的逻辑
+struct list_timer {
+    int64_t expire;
+    list_timer* prev;
+    list_timer* next;
+};
+
+class sort_timer_lst {
+   public:
+    sort_timer_lst() : head(NULL), tail(NULL) {}
+
+    void add_timer(list_timer* timer) {
+        timer->prev = timer->next = NULL;
+        if (!head) {
+            head = tail = timer;
+            return;
+        }
+        if (timer->expire < head->expire) {
+            timer->next = head;
+            head->prev = timer;
+            head = timer;
+            return;
+        }
+        add_timer(timer, head);
+    }
+
+    void adjust_timer(list_timer* timer) {
+        list_timer* tmp = timer->next;
+        if (!tmp || (timer->expire < tmp->expire)) {
+            return;
+        }
+        if (timer == head) {
+            head = head->next;
+            head->prev = NULL;
+            timer->next = NULL;
+            add_timer(timer, head);
+        } else {
+            timer->prev->next = timer->next;
+            timer->next->prev = timer->prev;
+            add_timer(timer, timer->next);
+        }
+    }
+
+    void del_timer(list_timer* timer) {
+        if (timer == head && timer == tail) {
+            head = tail = NULL;
+        } else if (timer == head) {
+            head = head->next;
+            head->prev = NULL;
+        } else if (timer == tail) {
+            tail = tail->prev;
+            tail->next = NULL;
+        } else {
+            timer->prev->next = timer->next;
+            timer->next->prev = timer->prev;
+        }
+    }
+
+   private:
+    void add_timer(list_timer* timer, list_timer* lst_head) {
+        list_timer* prev = lst_head;
+        list_timer* tmp = prev->next;
+        while (tmp) {
+            if (timer->expire < tmp->expire) {
+                prev->next = timer;
+                timer->next = tmp;
+                tmp->prev = timer;
+                timer->prev = prev;
+                break;
+            }
+            prev = tmp;
+            tmp = tmp->next;
+        }
+        if (!tmp) {
+            prev->next = timer;
+            timer->prev = prev;
+            timer->next = NULL;
+            tail = timer;
+        }
+    }
+
+    list_timer* head;
+    list_timer* tail;
+};
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void noop(client_data*) {}
+
+struct result {
+    double add;
+    double adjust;
+    double del;
+};
+
+// 防止编译器把结果当作无用而优化掉
+static volatile int64_t g_sink;
+
+static result bench_list(int n, int ops, const std::vector<int>& picks, int64_t base) {
+    std::vector<list_timer> nodes(n + ops);
+    sort_timer_lst lst;
+    // 按超时时间从晚到早插入，每次都落在表头，建表本身不计时
+    for (int i = n - 1; i >= 0; --i) {
+        nodes[i].expire = base + i;
+        lst.add_timer(&nodes[i]);
+    }
+
+    result r;
+    int64_t expire = base + n;
+    int64_t start = now_ns();
+    for (int i = 0; i < ops; ++i) {
+        nodes[n + i].expire = expire++;
+        lst.add_timer(&nodes[n + i]);
+    }
+    r.add = (double)(now_ns() - start) / ops;
+
+    start = now_ns();
+    for (int i = 0; i < ops; ++i) {
+        list_timer* t = &nodes[picks[i]];
+        t->expire = expire++;
+        lst.adjust_timer(t);
+    }
+    r.adjust = (double)(now_ns() - start) / ops;
+
+    start = now_ns();
+    for (int i = 0; i < ops; ++i) {
+        lst.del_timer(&nodes[picks[i]]);
+    }
+    r.del = (double)(now_ns() - start) / ops;
+    g_sink = nodes[0].expire;
+    return r;
+}
+
+static result bench_wheel(int n, int ops, const std::vector<int>& picks, int64_t base, int tick_ms) {
+    std::vector<client_data> users(n + ops);
+    timer_wheel wheel;
+    wheel.init(tick_ms);
+    for (int i = 0; i < n; ++i) {
+        users[i].timer_node.expire = base + i;
+        users[i].timer_node.cb_func = noop;
+        users[i].timer_node.user_data = &users[i];
+        wheel.add_timer(&users[i].timer_node);
+    }
+
+    result r;
+    int64_t expire = base + n;
+    int64_t start = now_ns();
+    for (int i = 0; i < ops; ++i) {
+        util_timer* t = &users[n + i].timer_node;
+        t->expire = expire++;
+        t->cb_func = noop;
+        t->user_data = &users[n + i];
+        wheel.add_timer(t);
+    }
+    r.add = (double)(now_ns() - start) / ops;
+
+    start = now_ns();
+    for (int i = 0; i < ops; ++i) {
+        util_timer* t = &users[picks[i]].timer_node;
+        t->expire = expire++;
+        wheel.adjust_timer(t);
+    }
+    r.adjust = (double)(now_ns() - start) / ops;
+
+    start = now_ns();
+    for (int i = 0; i < ops; ++i) {
+        wheel.del_timer(&users[picks[i]].timer_node);
+    }
+    r.del = (double)(now_ns() - start) / ops;
+    g_sink = users[0].timer_node.expire;
+    return r;
+}
+
+int main(int argc, char* argv[]) {
+    int ops = argc > 1 ? atoi(argv[1]) : 2000;
+    if (ops <= 0) {
+        fprintf(stderr, "usage: %s [ops]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%-8s %-6s %12s %12s %12s\n", "timers", "impl", "add ns/op", "adjust ns/op", "del ns/op");
+    const int sizes[] = {1000, 10000, 100000};
+    for (int n : sizes) {
+        // 推迟与删除的是随机挑选的互不相同的已有定时器
+        std::vector<int> picks(n);
+        for (int i = 0; i < n; ++i) {
+            picks[i] = i;
+        }
+        std::shuffle(picks.begin(), picks.end(), std::mt19937(n));
+        int count = std::min(ops, n);
+        picks.resize(count);
+
+        // 超时时间都在一分钟之后，计时期间不会有定时器到期
+        int64_t base = Utils::now_ms() + 60000;
+        result l = bench_list(n, count, picks, base);
+        result w = bench_wheel(n, count, picks, base, 100);
+        printf("%-8d %-6s %12.1f %12.1f %12.1f\n", n, "list", l.add, l.adjust, l.del);
+        printf("%-8d %-6s %12.1f %12.1f %12.1f\n", n, "wheel", w.add, w.adjust, w.del);
+    }
+    return 0;
+}
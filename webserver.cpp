@@ -1,9 +1,6 @@
 #include "webserver.h"
 
-WebServer::WebServer() {
-    // http_conn 类对象
-    users = new http_conn[MAX_FD];
-
+WebServer::WebServer() : users(MAX_FD), users_timer(MAX_FD) {
     // root 文件夹路径
     char server_path[200];
     getcwd(server_path, 200);
@@ -12,22 +9,35 @@ WebServer::WebServer() {
     strcpy(m_root, server_path);
     strcpy(m_root, root);
 
-    // 定时器
-    users_timer = new client_data[MAX_FD];
+    m_reactors = NULL;
+    m_next_reactor = 0;
+
+    m_uring_reactors = NULL;
+    m_uring_num = 0;
+
+    // 在创建任何线程之前屏蔽 SIGTERM、SIGHUP，所有线程继承该掩码，信号只能由主循环从 signalfd 读取
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+    m_signalfd = -1;
 }
 
 WebServer::~WebServer() {
     close(m_epollfd);
     close(m_listenfd);
-    close(m_pipefd[1]);
-    close(m_pipefd[0]);
-    delete[] users;
-    delete[] users_timer;
-    delete[] m_pool;
+    close(m_signalfd);
+    delete[] m_uring_reactors;
+    delete[] m_reactors;
+    delete m_pool;
 }
 
 void WebServer::init(int port, string user, string password, string databaseName, int log_write, int opt_linger,
-                     int trigmode, int sql_num, int thread_num, int close_log, int actor_model) {
+                     int trigmode, int sql_num, int thread_num, int close_log, int actor_model, int reactor_num,
+                     int dispatch_mode, int reuseport, int backlog, int io_backend, int steal, int zerocopy,
+                     int cache_size, string cache_control, int log_level, int access_sample,
+                     string log_rotate, int log_drop) {
     m_port = port;
     m_user = user;
     m_password = password;
@@ -39,11 +49,24 @@ void WebServer::init(int port, string user, string password, string databaseName
     m_TRIGMode = trigmode;
     m_close_log = close_log;
     m_actormodel = actor_model;
+    m_reactor_num = reactor_num;
+    m_dispatch_mode = dispatch_mode;
+    m_reuseport = reuseport;
+    m_backlog = backlog;
+    m_io_backend = io_backend;
+    m_steal = steal;
+    m_zerocopy = zerocopy;
+    m_cache_size = cache_size;
+    m_cache_control = cache_control;
+    m_log_level = log_level;
+    m_access_sample = access_sample;
+    m_log_rotate = log_rotate;
+    m_log_drop = log_drop;
 }
 
 void WebServer::thread_pool() {
     // 线程池
-    m_pool = new threadpool<http_conn>(m_actormodel, m_connPool, m_thread_num);
+    m_pool = new threadpool<http_conn>(m_actormodel, m_connPool, m_thread_num, 10000, m_steal);
 }
 
 void WebServer::sql_pool() {
@@ -52,14 +75,26 @@ void WebServer::sql_pool() {
     m_connPool->init("localhost", m_user, m_password, m_databaseName, 3306, m_sql_num, m_close_log);
 
     // 初始化数据库读取表
-    users->initmysql_result(m_connPool);
+    users[0].initmysql_result(m_connPool);
 }
 
 void WebServer::log_write() {
+    // 访问日志不受 -c 影响，只由采样率控制，总是异步写入
+    if (m_access_sample > 0) {
+        Log::get_access()->set_rotation(m_log_rotate.c_str());
+        Log::get_access()->set_drop(m_log_drop != 0);
+        Log::get_access()->init("./AccessLog", 0, 2000, 800000, 800);
+        http_conn::m_access_sample = m_access_sample;
+    }
     if (0 == m_close_log) {
+        Log::get_instance()->set_level(m_log_level);
+        Log::get_instance()->set_rotation(m_log_rotate.c_str());
+        Log::get_instance()->set_drop(m_log_drop != 0);
         // 初始化日志
         if (1 == m_log_write) {
             Log::get_instance()->init("./ServerLog", m_close_log, 2000, 800000, 800);
+        } else if (2 == m_log_write) {
+            Log::get_instance()->init("./ServerLog.bin", m_close_log, 2000, 800000, 800, true);
         } else {
             Log::get_instance()->init("./ServerLog", m_close_log, 2000, 800000, 0);
         }
@@ -89,18 +124,19 @@ void WebServer::trig_mode() {
     }
 }
 
-void WebServer::eventListen() {
+// 创建、绑定并监听一个 socket，reuseport 为 true 时允许多个 socket 绑定同一端口
+int WebServer::listen_socket(bool reuseport) {
     // 网络编程基础步骤
-    m_listenfd = socket(PF_INET, SOCK_STREAM, 0);
-    assert(m_listenfd >= 0);
+    int listenfd = socket(PF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    assert(listenfd >= 0);
 
     // 优雅关闭连接
     if (0 == m_OPT_LINGER) {
         struct linger tmp = {0, 1};
-        setsockopt(m_listenfd, SOL_SOCKET, SO_LINGER, &tmp, sizeof(tmp));
+        setsockopt(listenfd, SOL_SOCKET, SO_LINGER, &tmp, sizeof(tmp));
     } else if (1 == m_OPT_LINGER) {
         struct linger tmp = {1, 1};
-        setsockopt(m_listenfd, SOL_SOCKET, SO_LINGER, &tmp, sizeof(tmp));
+        setsockopt(listenfd, SOL_SOCKET, SO_LINGER, &tmp, sizeof(tmp));
     }
 
     int ret = 0;
@@ -111,42 +147,107 @@ void WebServer::eventListen() {
     address.sin_port = htons(m_port);
 
     int flag = 1;
-    setsockopt(m_listenfd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
-    ret = bind(m_listenfd, (struct sockaddr*)&address, sizeof(address));
+    setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+    if (reuseport) {
+        // 内核按四元组哈希把新连接分摊到绑定同一端口的各个 socket 上
+        ret = setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, &flag, sizeof(flag));
+        assert(ret >= 0);
+    }
+    ret = bind(listenfd, (struct sockaddr*)&address, sizeof(address));
     assert(ret >= 0);
-    ret = listen(m_listenfd, 5);
+    ret = listen(listenfd, m_backlog);
     assert(ret >= 0);
 
-    utils.init(TIMESLOT);
+    return listenfd;
+}
+
+// 创建 io_uring reactor，内核不支持 io_uring 或 provided buffers 时返回 false，回退到 epoll
+bool WebServer::uring_listen() {
+    int num = m_reactor_num > 0 ? m_reactor_num : 1;
+
+    // 各 reactor 共用一个阻塞的监听 socket，accept 由 io_uring 异步完成
+    m_listenfd = listen_socket(1 == m_reuseport);
+    m_uring_reactors = new uring_reactor[num];
+    for (int i = 0; i < num; i++) {
+        if (!m_uring_reactors[i].init(this, m_listenfd)) {
+            LOG_WARN("io_uring unavailable, errno is:%d, fall back to epoll", errno);
+            delete[] m_uring_reactors;
+            m_uring_reactors = NULL;
+            close(m_listenfd);
+            m_listenfd = -1;
+            return false;
+        }
+    }
+
+    m_uring_num = num;
+    return true;
+}
 
+void WebServer::eventListen() {
     // epoll 创建内核事件表
     epoll_event events[MAX_EVENT_NUMBER];
     m_epollfd = epoll_create(5);
     assert(m_epollfd != -1);
 
-    utils.addfd(m_epollfd, m_listenfd, false, m_LISTENTrigmode);
-    http_conn::m_epollfd = m_epollfd;
+    if (1 == m_io_backend && uring_listen()) {
+        // io_uring reactor 接管全部连接，主线程只处理信号
+    } else {
+        // 单 reactor 时主线程直接处理连接事件；否则每个从 reactor 拥有独立的内核事件表
+        if (m_reactor_num > 0) {
+            m_reactors = new sub_reactor[m_reactor_num];
+            for (int i = 0; i < m_reactor_num; i++) {
+                m_reactors[i].init(this);
+            }
+        } else {
+            m_reactors = new sub_reactor[1];
+            m_reactors[0].init(this, m_epollfd);
+        }
 
-    ret = socketpair(PF_UNIX, SOCK_STREAM, 0, m_pipefd);
-    assert(ret != -1);
-    utils.setnonblocking(m_pipefd[1]);
-    utils.addfd(m_epollfd, m_pipefd[0], false, 0);
+        if (1 == m_reuseport && m_reactor_num > 0) {
+            // 每个从 reactor 监听自己的 SO_REUSEPORT socket 并自行 accept，主 reactor 只处理信号
+            m_listenfd = -1;
+            for (int i = 0; i < m_reactor_num; i++) {
+                m_reactors[i].listen_on(listen_socket(true));
+            }
+        } else {
+            m_listenfd = listen_socket(1 == m_reuseport);
+            utils.addfd(m_epollfd, m_listenfd, false, m_LISTENTrigmode);
+        }
+    }
 
-    utils.addsig(SIGPIPE, SIG_IGN);
-    utils.addsig(SIGALRM, utils.sig_handler, false);
-    utils.addsig(SIGTERM, utils.sig_handler, false);
+    // 文件缓存按实际使用的后端选择打开方式：只有 epoll 后端的零拷贝模式用 sendfile
+    file_cache::get_instance()->init((size_t)m_cache_size << 20, m_zerocopy && 0 == m_uring_num, m_close_log);
+    // 即时压缩的变体另有预算，为文件缓存的四分之一
+    gzip_cache::get_instance()->init((size_t)m_cache_size << 18);
+    if (!cache_policy::get_instance()->init(m_cache_control.c_str())) {
+        LOG_WARN("ignored malformed or over-long Cache-Control rules in: %s", m_cache_control.c_str());
+    }
 
-    alarm(TIMESLOT);
+    utils.addsig(SIGPIPE, SIG_IGN);
 
-    // 工具类，信号和描述符基础操作
-    Utils::u_pipefd = m_pipefd;
-    Utils::u_epollfd = m_epollfd;
+    // 构造函数中已屏蔽的信号改由 signalfd 在主循环中同步处理
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGHUP);
+    m_signalfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    assert(m_signalfd != -1);
+    utils.addfd(m_epollfd, m_signalfd, false, 0);
 }
 
 void WebServer::eventLoop() {
-    bool timeout = false;
     bool stop_server = false;
 
+    if (m_uring_num > 0) {
+        for (int i = 0; i < m_uring_num; i++) {
+            m_uring_reactors[i].start();
+        }
+    } else {
+        for (int i = 0; i < m_reactor_num; i++) {
+            m_reactors[i].start();
+        }
+    }
+
     while (!stop_server) {
         int number = epoll_wait(m_epollfd, events, MAX_EVENT_NUMBER, -1);
         if (number < 0 && errno != EINTR) {
@@ -159,212 +260,121 @@ void WebServer::eventLoop() {
 
             // 处理新到的客户连接
             if (sockfd == m_listenfd) {
-                bool flag = deal_clientData();
+                bool flag = deal_clientData(m_listenfd, NULL);
                 if (false == flag) {
                     continue;
                 }
-            } else if (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
-                // 服务器端关闭连接，移除对应的定时器
-                util_timer* timer = users_timer[sockfd].timer;
-                deal_timer(timer, sockfd);
-            } else if ((sockfd == m_pipefd[0]) && (events[i].events & EPOLLIN)) {
+            } else if (sockfd == m_signalfd) {
                 // 处理信号
-                bool flag = deal_with_signal(timeout, stop_server);
+                bool flag = deal_with_signal(stop_server);
                 if (false == flag) {
                     LOG_ERROR("%s", "deal client data failure");
                 }
-            } else if (events[i].events & EPOLLIN) {
-                // 处理客户连接上接收到的数据
-                deal_with_read(sockfd);
-            } else if (events[i].events & EPOLLOUT) {
-                deal_with_write(sockfd);
+            } else {
+                // 单 reactor 模式下的连接事件
+                m_reactors[0].handle_event(events[i]);
             }
         }
-        if (timeout) {
-            utils.timer_handler();
-
-            LOG_INFO("%s", "time tick");
-
-            timeout = false;
-        }
-    }
-}
-
-void WebServer::timer(int connfd, struct sockaddr_in client_address) {
-    users[connfd].init(connfd, client_address, m_root, m_CONNTrigmode, m_close_log, m_user, m_password, m_databaseName);
-
-    // 初始化 client_data 数据
-    // 创建定时器，设置回调函数和超时时间，绑定用户数据，将定时器添加到链表中
-    users_timer[connfd].address = client_address;
-    users_timer[connfd].sockfd = connfd;
-
-    util_timer* timer = new util_timer;
-    timer->user_data = &users_timer[connfd];
-    timer->cb_func = cb_func;
-    time_t cur = time(NULL);
-    timer->expire = cur + 3 * TIMESLOT;
-
-    users_timer[connfd].timer = timer;
-    utils.m_timer_lst.add_timer(timer);
-}
-
-// 若有数据传输，则将定时器往后延迟 3 个单位
-// 并对新的定时器在链表上的位置进行调整
-void WebServer::adjust_timer(util_timer* timer) {
-    time_t cur = time(NULL);
-    timer->expire = cur + 3 * TIMESLOT;
-    utils.m_timer_lst.adjust_timer(timer);
-
-    LOG_INFO("%s", "adjust timer once");
-}
-
-void WebServer::deal_timer(util_timer* timer, int sockfd) {
-    timer->cb_func(&users_timer[sockfd]);
-    if (timer) {
-        utils.m_timer_lst.del_timer(timer);
     }
 
-    LOG_INFO("close fd %d", users_timer[sockfd].sockfd);
-}
-bool WebServer::deal_clientData() {
-    struct sockaddr_in client_address;
-    socklen_t client_addrLength = sizeof(client_address);
-    if (0 == m_LISTENTrigmode) {
-        int connfd = accept(m_listenfd, (struct sockaddr*)&client_address, &client_addrLength);
-        if (connfd < 0) {
-            LOG_ERROR("%s:errno is:%d", "accept error", errno);
-            return false;
+    if (m_uring_num > 0) {
+        for (int i = 0; i < m_uring_num; i++) {
+            m_uring_reactors[i].stop();
         }
-
-        if (http_conn::m_user_count >= MAX_FD) {
-            utils.show_error(connfd, "Internal server busy");
-            LOG_ERROR("%s", "Internal server busy");
-            return false;
-        }
-
-        timer(connfd, client_address);
     } else {
-        while (true) {
-            int connfd = accept(m_listenfd, (struct sockaddr*)&client_address, &client_addrLength);
-            if (connfd < 0) {
-                LOG_ERROR("%s:errno is:%d", "accept error", errno);
-                break;
-            }
-
-            if (http_conn::m_user_count >= MAX_FD) {
-                utils.show_error(connfd, "Internal server busy");
-                LOG_ERROR("%s", "Internal server busy");
-                break;
-            }
-
-            timer(connfd, client_address);
+        for (int i = 0; i < m_reactor_num; i++) {
+            m_reactors[i].stop();
         }
-        return false;
     }
-
-    return true;
 }
 
-bool WebServer::deal_with_signal(bool& timeout, bool& stop_server) {
-    int ret = 0;
-    int sig;
-    char signals[1024];
-    ret = recv(m_pipefd[0], signals, sizeof(signals), 0);
-    if (ret == -1 || ret == 0) {
-        return false;
-    } else {
-        for (int i = 0; i < ret; i++) {
-            switch (signals[i]) {
-                case SIGALRM: {
-                    timeout = true;
-                    break;
-                }
-                case SIGTERM: {
-                    stop_server = true;
-                    break;
-                }
+// 将新连接交给某个 reactor 管理
+void WebServer::dispatch(int connfd, const sockaddr_in& client_address) {
+    if (0 == m_reactor_num) {
+        m_reactors[0].timer(connfd, client_address);
+        return;
+    }
+
+    int idx = 0;
+    if (1 == m_dispatch_mode) {
+        // 最少连接
+        for (int i = 1; i < m_reactor_num; i++) {
+            if (m_reactors[i].conn_count() < m_reactors[idx].conn_count()) {
+                idx = i;
             }
         }
+    } else {
+        // 轮询
+        idx = m_next_reactor;
+        m_next_reactor = (m_next_reactor + 1) % m_reactor_num;
     }
-
-    return true;
+    m_reactors[idx].add_conn(connfd, client_address);
 }
 
-void WebServer::deal_with_read(int sockfd) {
-    util_timer* timer = users_timer[sockfd].timer;
-
-    if (1 == m_actormodel) {
-        // reactor
-
-        if (timer) {
-            adjust_timer(timer);
-        }
-
-        // 若监测到读事件，将该事件放入请求队列
-        m_pool->append(users + sockfd, 0);
-
-        while (true) {
-            if (1 == users[sockfd].improv) {
-                if (1 == users[sockfd].timer_flag) {
-                    deal_timer(timer, sockfd);
-                    users[sockfd].timer_flag = 0;
-                }
-                users[sockfd].improv = 0;
-                break;
+// 从 listenfd 上批量接受新连接，reactor 为 NULL 时按分发策略交给从 reactor，否则由该 reactor 直接管理
+bool WebServer::deal_clientData(int listenfd, sub_reactor* reactor) {
+    // LT 模式下每次最多接受 ACCEPT_BATCH 个连接，避免饿死其他事件；ET 模式必须一直接受到 EAGAIN
+    int batch = (0 == m_LISTENTrigmode) ? ACCEPT_BATCH : MAX_FD;
+    int accepted = 0;
+
+    while (accepted < batch) {
+        struct sockaddr_in client_address;
+        socklen_t client_addrLength = sizeof(client_address);
+        // accept4 直接返回非阻塞的 connfd，省去 fcntl
+        int connfd = accept4(listenfd, (struct sockaddr*)&client_address, &client_addrLength,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (connfd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_ERROR("%s:errno is:%d", "accept error", errno);
             }
+            break;
         }
-    } else {
-        // proactor
-
-        if (users[sockfd].read_once()) {
-            LOG_INFO("deal with the client(%s)", inet_ntoa(users[sockfd].get_address()->sin_addr));
 
-            // 若监测到读事件，将该事件放入请求队列
-            m_pool->append_p(users + sockfd);
+        if (http_conn::m_user_count >= MAX_FD) {
+            utils.show_error(connfd, "Internal server busy");
+            LOG_ERROR("%s", "Internal server busy");
+            break;
+        }
 
-            if (timer) {
-                adjust_timer(timer);
-            }
+        if (reactor) {
+            reactor->timer(connfd, client_address);
         } else {
-            deal_timer(timer, sockfd);
+            dispatch(connfd, client_address);
         }
+        accepted++;
     }
-}
 
-void WebServer::deal_with_write(int sockfd) {
-    util_timer* timer = users_timer[sockfd].timer;
-
-    if (1 == m_actormodel) {
-        // reactor
-
-        if (timer) {
-            adjust_timer(timer);
-        }
+    return accepted > 0;
+}
 
-        // 若监测到写事件，将该事件放入请求队列
-        m_pool->append(users + sockfd, 1);
+bool WebServer::deal_with_signal(bool& stop_server) {
+    struct signalfd_siginfo info;
+    bool ret = false;
 
-        while (true) {
-            if (1 == users[sockfd].improv) {
-                if (1 == users[sockfd].timer_flag) {
-                    deal_timer(timer, sockfd);
-                    users[sockfd].timer_flag = 0;
-                }
-                users[sockfd].improv = 0;
+    while (read(m_signalfd, &info, sizeof(info)) == sizeof(info)) {
+        ret = true;
+        switch (info.ssi_signo) {
+            case SIGTERM: {
+                stop_server = true;
                 break;
             }
-        }
-    } else {
-        // proactor
-
-        if (users[sockfd].write()) {
-            LOG_INFO("send data to the client(%s)", inet_ntoa(users[sockfd].get_address()->sin_addr));
-
-            if (timer) {
-                adjust_timer(timer);
+            case SIGHUP: {
+                // 脱离终端时不退出，输出文件缓存的计数器，用于确定缓存大小
+                file_cache::stats st = file_cache::get_instance()->get_stats();
+                LOG_INFO("receive SIGHUP, file cache: hits %llu misses %llu evictions %llu invalidations %llu "
+                         "entries %llu bytes %llu",
+                         (unsigned long long)st.hits, (unsigned long long)st.misses, (unsigned long long)st.evictions,
+                         (unsigned long long)st.invalidations, (unsigned long long)st.entries,
+                         (unsigned long long)st.bytes);
+                gzip_cache::stats gz = gzip_cache::get_instance()->get_stats();
+                LOG_INFO("gzip cache: hits %llu compressions %llu precompressed %llu entries %llu bytes %llu",
+                         (unsigned long long)gz.hits, (unsigned long long)gz.compressions,
+                         (unsigned long long)gz.precompressed, (unsigned long long)gz.entries,
+                         (unsigned long long)gz.bytes);
+                break;
             }
-        } else {
-            deal_timer(timer, sockfd);
         }
     }
-}
\ No newline at end of file
+
+    return ret;
+}
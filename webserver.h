@@ -11,13 +11,21 @@
 #include <stdlib.h>
 #include <cassert>
 #include <sys/epoll.h>
+#include <sys/signalfd.h>
 
 #include "./threadpool/threadpool.h"
 #include "./http/http_conn.h"
+#include "./memorypool/fd_table.h"
+#include "./reactor/sub_reactor.h"
+#include "./reactor/uring_reactor.h"
 
 const int MAX_FD = 65536;           // 最大文件描述符
 const int MAX_EVENT_NUMBER = 10000; // 最大事件数
-const int TIMESLOT = 5;             // 最小超时单位
+const int TIMESLOT = 100;           // 定时器检查间隔（毫秒）
+const int IDLE_TIMEOUT = 15000;     // 新连接等待首个请求的超时时间（毫秒）
+const int HEADER_TIMEOUT = 10000;   // 请求尚未接收完整时的超时时间（毫秒）
+const int KEEPALIVE_TIMEOUT = 15000; // 长连接等待下一个请求的超时时间（毫秒）
+const int ACCEPT_BATCH = 64;        // LT 模式下一次就绪事件最多接受的连接数
 
 class WebServer {
 public:
@@ -26,21 +34,21 @@ public:
 
     void init(int port, string user, string password, string databaseName,
             int log_write, int opt_linger, int trigmode, int sql_num,
-            int thread_num, int close_log, int actor_model);
+            int thread_num, int close_log, int actor_model, int reactor_num, int dispatch_mode,
+            int reuseport, int backlog, int io_backend, int steal, int zerocopy, int cache_size,
+            string cache_control, int log_level, int access_sample, string log_rotate, int log_drop);
 
     void thread_pool();
     void sql_pool();
     void log_write();
     void trig_mode();
+    int listen_socket(bool reuseport);
+    bool uring_listen();
     void eventListen();
     void eventLoop();
-    void timer(int connfd, struct sockaddr_in client_address);
-    void adjust_timer(util_timer* timer);
-    void deal_timer(util_timer* timer, int sockfd);
-    bool deal_clientData();
-    bool deal_with_signal(bool& timeout, bool& stop_server);
-    void deal_with_read(int sockfd);
-    void deal_with_write(int sockfd);
+    bool deal_clientData(int listenfd, sub_reactor* reactor);
+    bool deal_with_signal(bool& stop_server);
+    void dispatch(int connfd, const sockaddr_in& client_address);
 
 public:
     // 基础
@@ -50,9 +58,28 @@ public:
     int m_close_log;
     int m_actormodel;
 
-    int m_pipefd[2];
+    // 主从 reactor 相关
+    int m_reactor_num;       // 从 reactor 数量，0 表示单 reactor
+    int m_dispatch_mode;     // 新连接分发策略，0 轮询，1 最少连接
+    int m_next_reactor;      // 轮询分发的下一个从 reactor
+    sub_reactor* m_reactors;
+
+    // io_uring 后端相关
+    int m_io_backend;        // I/O 后端，0 epoll，1 io_uring
+    int m_uring_num;         // io_uring reactor 数量，回退到 epoll 时为 0
+    uring_reactor* m_uring_reactors;
+
+    int m_zerocopy;         // 是否用 sendfile 发送静态文件
+    int m_cache_size;       // 静态文件缓存大小（MB）
+    string m_cache_control; // 按路径前缀配置的 Cache-Control
+    int m_log_level;        // 运行日志的最低级别
+    int m_access_sample;    // 访问日志采样率，0 为不写
+    string m_log_rotate;    // 日志切分、压缩与保留策略
+    int m_log_drop;         // 后台线程跟不上时是否丢弃 debug 与 info 日志
+
+    int m_signalfd;         // SIGTERM、SIGHUP 通过 signalfd 同步读取
     int m_epollfd;
-    http_conn* users;
+    fd_table<http_conn> users;  // 连接对象按描述符惰性分配
 
     // 数据库相关
     connection_pool* m_connPool;
@@ -64,18 +91,21 @@ public:
     // 线程池相关
     threadpool<http_conn>* m_pool;
     int m_thread_num;
+    int m_steal;            // 线程池是否使用工作窃取
 
     // epoll_event 相关
     epoll_event events[MAX_EVENT_NUMBER];
 
     int m_listenfd;
+    int m_reuseport;        // 是否为每个从 reactor 创建 SO_REUSEPORT 监听 socket
+    int m_backlog;          // listen 的全连接队列长度
     int m_OPT_LINGER;
     int m_TRIGMode;
     int m_LISTENTrigmode;
     int m_CONNTrigmode;
 
     // 定时器相关
-    client_data* users_timer;
+    fd_table<client_data> users_timer;
     Utils utils;
 };
 